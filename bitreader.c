@@ -8,6 +8,7 @@ BITREADER* bropen(const char* filename) {
     br->file = f;
     br->current = 0;
     br->offset = 0;
+    br->position = 0;
     return br;
 }
 
@@ -17,6 +18,8 @@ BITREADER* brattach(FILE* stream) {
     br->file = stream;
     br->current = 0;
     br->offset = 0;
+    br->position = 0;
+    return br;
 }
 
 int brreadbits(BITREADER* reader, int n) {
@@ -26,6 +29,7 @@ int brreadbits(BITREADER* reader, int n) {
             int next_char = fgetc(reader->file);
             if (next_char == EOF) return EOF;
             reader->current = next_char;
+            ++reader->position;
         }
         if (reader->current & (1 << reader->offset)) result |= (1 << i);
         ++reader->offset;
@@ -38,16 +42,28 @@ int brread_uint8(BITREADER* reader) {
     reader->offset = 0;
     uint8_t c;
     if (fread(&c, 1, 1, reader->file) == 0) return EOF;
+    ++reader->position;
     return c;
 }
 
 int brread_uint16(BITREADER* reader) {
     reader->offset = 0;
-    uint16_t ls, ms;
+    uint8_t ls, ms;
     if (fread(&ls, 1, 1, reader->file) == 0 || fread(&ms, 1, 1, reader->file) == 0) return EOF;
+    reader->position += 2;
     return ls + (ms << 8);
 }
 
+size_t brtell(const BITREADER* reader) {
+    return reader->position * 8 - (reader->offset ? 8 - reader->offset : 0);
+}
+
+int brpeek_uint8(BITREADER* reader) {
+    int next_char = fgetc(reader->file);
+    if (next_char != EOF) ungetc(next_char, reader->file);
+    return next_char;
+}
+
 int brclose(BITREADER* reader) {
     if (!reader) return 0;
     int result = fclose(reader->file);
@@ -9,11 +9,13 @@
  * @param file: the file being read from
  * @param current: the character being read
  * @param offset: the current bit being read in the character (0-7)
+ * @param position: the number of bytes read from the file so far
  */
 typedef struct __BITREADER {
     FILE* file;
     char current;
     int offset;
+    size_t position;
 } BITREADER;
 
 /**
@@ -59,6 +61,23 @@ int brread_uint8(BITREADER* reader);
  */
 int brread_uint16(BITREADER* reader);
 
+/**
+ * Returns the number of bits consumed from the bit reader so far.
+ * 
+ * @param reader: the bit reader
+ * @returns the number of bits read since the bit reader was created
+ */
+size_t brtell(const BITREADER* reader);
+
+/**
+ * Returns the next byte of the bit reader's stream without consuming it.
+ * Any bits left in a partially read byte are not counted.
+ * 
+ * @param reader: the bit reader
+ * @returns the next byte, or EOF if the end of the stream was reached
+ */
+int brpeek_uint8(BITREADER* reader);
+
 /**
  * Closes the bit reader's file stream and frees the bit reader.
  * If the bit reader is NULL, nothing will happen.
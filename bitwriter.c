@@ -0,0 +1,62 @@
+#include <stdlib.h>
+#include "bitwriter.h"
+
+BITWRITER* bwattach(VECTOR* vector) {
+    if (!vector) return NULL;
+    BITWRITER* bw = malloc(sizeof(BITWRITER));
+    bw->vector = vector;
+    bw->buffer = 0;
+    bw->count = 0;
+    return bw;
+}
+
+void bwwritebits(BITWRITER* writer, uint32_t value, int n) {
+    if (n < 32) value &= ((uint32_t) 1 << n) - 1;
+    writer->buffer |= (uint64_t) value << writer->count;
+    writer->count += n;
+    while (writer->count >= 8) {
+        vec_push_back(writer->vector, (char) writer->buffer);
+        writer->buffer >>= 8;
+        writer->count -= 8;
+    }
+}
+
+void bwalign(BITWRITER* writer) {
+    if (writer->count) bwwritebits(writer, 0, 8 - writer->count);
+}
+
+void bwwrite_uint8(BITWRITER* writer, uint8_t value) {
+    bwalign(writer);
+    vec_push_back(writer->vector, (char) value);
+}
+
+void bwwrite_uint16(BITWRITER* writer, uint16_t value) {
+    bwalign(writer);
+    vec_push_back(writer->vector, (char) (value & 0xFF));
+    vec_push_back(writer->vector, (char) (value >> 8));
+}
+
+void bwappend(BITWRITER* writer, const char* data, size_t n) {
+    if (!writer->count) {
+        for (size_t i = 0; i < n / 8; i++) {
+            vec_push_back(writer->vector, data[i]);
+        }
+    } else {
+        for (size_t i = 0; i < n / 8; i++) {
+            bwwritebits(writer, (uint8_t) data[i], 8);
+        }
+    }
+    if (n % 8) bwwritebits(writer, (uint8_t) data[n / 8], n % 8);
+}
+
+size_t bwtell(const BITWRITER* writer) {
+    return vec_size(writer->vector) * 8 + writer->count;
+}
+
+VECTOR* bwfree(BITWRITER* writer) {
+    if (!writer) return NULL;
+    bwalign(writer);
+    VECTOR* vector = writer->vector;
+    free(writer);
+    return vector;
+}
\ No newline at end of file
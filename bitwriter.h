@@ -0,0 +1,88 @@
+#ifndef BITWRITER_H
+#define BITWRITER_H
+
+#include "vector.h"
+#include <stdint.h>
+
+/**
+ * Structure for writing individual bits to a vector, in the order DEFLATE expects (least significant bit first).
+ * @param vector: the vector being written to
+ * @param buffer: bits that have not been pushed to the vector yet
+ * @param count: the number of bits in the buffer (0-7 between calls)
+ */
+typedef struct __BITWRITER {
+    VECTOR* vector;
+    uint64_t buffer;
+    int count;
+} BITWRITER;
+
+/**
+ * Creates a new bit writer that appends to a vector.
+ * The bit writer must be freed later with bwfree() to avoid memory leaks.
+ * 
+ * @param vector: the vector to write to
+ * @returns the bit writer, or NULL if the vector was NULL
+ */
+BITWRITER* bwattach(VECTOR* vector);
+
+/**
+ * Writes some number of bits to a bit writer.
+ * The LSB of the value will be written first.
+ * 
+ * @param writer: the bit writer to write to
+ * @param value: the bits to write
+ * @param n: the number of bits to write (at most 32)
+ */
+void bwwritebits(BITWRITER* writer, uint32_t value, int n);
+
+/**
+ * Pads the bit writer with zeros up to the next byte boundary.
+ * 
+ * @param writer: the bit writer
+ */
+void bwalign(BITWRITER* writer);
+
+/**
+ * Writes a byte to the bit writer, after padding up to the next byte boundary.
+ * 
+ * @param writer: the bit writer
+ * @param value: the byte to write
+ */
+void bwwrite_uint8(BITWRITER* writer, uint8_t value);
+
+/**
+ * Writes an unsigned 16-bit integer in little-endian format, after padding up to the next byte boundary.
+ * 
+ * @param writer: the bit writer
+ * @param value: the integer to write
+ */
+void bwwrite_uint16(BITWRITER* writer, uint16_t value);
+
+/**
+ * Writes bits that were produced by another bit writer.
+ * 
+ * @param writer: the bit writer to write to
+ * @param data: the bytes holding the bits, least significant bit first
+ * @param n: the number of bits to copy from data
+ */
+void bwappend(BITWRITER* writer, const char* data, size_t n);
+
+/**
+ * Returns the number of bits written to the bit writer's vector so far, including the buffered ones.
+ * 
+ * @param writer: the bit writer
+ * @returns the number of bits written
+ */
+size_t bwtell(const BITWRITER* writer);
+
+/**
+ * Pushes any buffered bits to the vector, padded with zeros to a whole byte, and frees the bit writer.
+ * The vector is not freed.
+ * If the bit writer is NULL, nothing will happen.
+ * 
+ * @param writer: the bit writer to free
+ * @returns the vector, or NULL if the bit writer was NULL
+ */
+VECTOR* bwfree(BITWRITER* writer);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,29 @@
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Updates a running CRC-32 (as used by gzip) with more data.
+ * Start with a checksum of 0 for an empty message.
+ * 
+ * @param crc: the checksum of the data seen so far
+ * @param data: the data to add
+ * @param size: the number of bytes in data
+ * @returns the checksum including the new data
+ */
+uint32_t checksum_crc32(uint32_t crc, const char* data, size_t size);
+
+/**
+ * Updates a running Adler-32 checksum (as used by zlib) with more data.
+ * Start with a checksum of 1 for an empty message.
+ * 
+ * @param adler: the checksum of the data seen so far
+ * @param data: the data to add
+ * @param size: the number of bytes in data
+ * @returns the checksum including the new data
+ */
+uint32_t checksum_adler32(uint32_t adler, const char* data, size_t size);
+
+#endif
\ No newline at end of file
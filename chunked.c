@@ -0,0 +1,208 @@
+#include "chunked.h"
+#include "encoder.h"
+#include "workqueue.h"
+#include <stdint.h>
+#include <stdlib.h>
+
+#define CHAIN_HASH_BITS 15
+#define MAX_CHAIN 128       // hash chain links followed per search
+#define GOOD_LENGTH 8       // previous match length above which only a quarter of the chain is searched
+#define LAZY_LENGTH 16      // previous match length above which the next position isn't searched
+#define NICE_LENGTH 128     // match length that ends a search early
+#define TOO_FAR 4096        // distance above which a match of length 3 isn't worth it
+#define BLOCK_ITEMS 32768   // most LZ77 items per block
+#define NO_POSITION -1
+
+/**
+ * A chunk of the input and the bytes it was compressed to.
+ */
+typedef struct __CHUNK {
+    const char* data;       // the whole input
+    size_t start;
+    size_t end;
+    int final;              // 1 if this is the last chunk, which ends with the final block
+    int independent;        // 1 if matches may not reach into the previous chunk
+    VECTOR* output;
+} CHUNK;
+
+/**
+ * Hash chains over a chunk and its dictionary. Positions are relative to the start of the dictionary.
+ */
+typedef struct __CHAINS {
+    const uint8_t* data;    // start of the dictionary
+    int32_t* head;          // most recent position for each hash
+    int32_t* prev;          // previous position with the same hash, for each position
+} CHAINS;
+
+/**
+ * Private function to add a position to the front of its hash chain.
+ *
+ * @param chains: the hash chains
+ * @param pos: the position, which must have at least MIN_MATCH bytes after it
+ */
+void chain_insert(CHAINS* chains, int32_t pos) {
+    uint32_t hash = encoder_hash3(chains->data + pos, CHAIN_HASH_BITS);
+    chains->prev[pos] = chains->head[hash];
+    chains->head[hash] = pos;
+}
+
+/**
+ * Private function to find the longest match at a position by following its hash chain.
+ *
+ * @param chains: the hash chains
+ * @param pos: the position to match, which has not been inserted yet
+ * @param max_length: the longest match allowed
+ * @param prev_length: the length of the match at the previous position, which a new match must beat
+ * @param distance: pointer to write the distance of the match to
+ * @returns the length of the match, or 0 if there is no match longer than prev_length
+ */
+int chain_find(const CHAINS* chains, int32_t pos, int max_length, int prev_length, int* distance) {
+    const uint8_t* data = chains->data;
+    int best_length = (prev_length < MIN_MATCH - 1) ? MIN_MATCH - 1 : prev_length;
+    int found = 0;
+    int chain = (prev_length >= GOOD_LENGTH) ? MAX_CHAIN / 4 : MAX_CHAIN;
+    if (best_length >= max_length) return 0;
+    for (int32_t node = chains->head[encoder_hash3(data + pos, CHAIN_HASH_BITS)];
+         node != NO_POSITION && pos - node <= WINDOW_SIZE && chain--; node = chains->prev[node]) {
+        if (data[node + best_length] != data[pos + best_length] || data[node] != data[pos]) continue;
+        int length = 0;
+        while (length < max_length && data[node + length] == data[pos + length]) length++;
+        if (length > best_length) {
+            best_length = length;
+            *distance = pos - node;
+            found = 1;
+            if (length >= NICE_LENGTH || length == max_length) break;
+        }
+    }
+    if (!found || (best_length == MIN_MATCH && *distance > TOO_FAR)) return 0;
+    return best_length;
+}
+
+/**
+ * Private function to append a literal or a match to a parse.
+ *
+ * @param items: the parse
+ * @param num_items: pointer to the number of items in the parse
+ * @param length: the match length, or the literal byte
+ * @param distance: the match distance, or 0 for a literal
+ */
+void chunk_emit(LZ77_ITEM* items, size_t* num_items, int length, int distance) {
+    items[*num_items].length = length;
+    items[(*num_items)++].distance = distance;
+}
+
+/**
+ * Private function to parse a chunk with lazy matching: a match is only taken if the next position
+ * doesn't start a longer one.
+ *
+ * @param chains: the hash chains, which already hold the dictionary
+ * @param start: position of the first byte of the chunk
+ * @param end: position after the last byte of the chunk
+ * @param items: array of at least end - start items to write the parse to
+ * @returns the number of items written
+ */
+size_t chunk_parse(CHAINS* chains, int32_t start, int32_t end, LZ77_ITEM* items) {
+    size_t num_items = 0;
+    int prev_length = 0, prev_distance = 0, pending = 0;
+    for (int32_t pos = start; pos < end;) {
+        int length = 0, distance = 0;
+        if (end - pos >= MIN_MATCH) {
+            int max_length = (end - pos < MAX_MATCH) ? end - pos : MAX_MATCH;
+            if (!pending || prev_length < LAZY_LENGTH) length = chain_find(chains, pos, max_length, prev_length, &distance);
+            chain_insert(chains, pos);
+        }
+        if (pending && prev_length >= MIN_MATCH && length <= prev_length) {
+            // The match at the previous position wins; insert the rest of the positions it covers
+            chunk_emit(items, &num_items, prev_length, prev_distance);
+            for (int32_t i = pos + 1; i < pos - 1 + prev_length; i++) {
+                if (end - i >= MIN_MATCH) chain_insert(chains, i);
+            }
+            pos += prev_length - 1;
+            pending = 0;
+            prev_length = 0;
+            continue;
+        }
+        if (pending) chunk_emit(items, &num_items, chains->data[pos - 1], 0);
+        pending = 1;
+        prev_length = length;
+        prev_distance = distance;
+        pos++;
+    }
+    if (pending) {
+        if (prev_length >= MIN_MATCH) chunk_emit(items, &num_items, prev_length, prev_distance);
+        else chunk_emit(items, &num_items, chains->data[end - 1], 0);
+    }
+    return num_items;
+}
+
+/**
+ * Private function to compress one chunk into its own vector.
+ *
+ * @param item: the chunk to compress
+ */
+void compress_chunk(void* item) {
+    CHUNK* chunk = item;
+    size_t dictionary = chunk->independent ? 0 : (chunk->start < WINDOW_SIZE) ? chunk->start : WINDOW_SIZE;
+    int32_t start = dictionary, end = dictionary + chunk->end - chunk->start;
+    CHAINS chains = {(const uint8_t*) chunk->data + chunk->start - dictionary, malloc(sizeof(int32_t) << CHAIN_HASH_BITS),
+                     malloc((end + 1) * sizeof(int32_t))};
+    LZ77_ITEM* items = malloc((end - start + 1) * sizeof(LZ77_ITEM));
+    for (size_t i = 0; i < (1 << CHAIN_HASH_BITS); i++) {
+        chains.head[i] = NO_POSITION;
+    }
+    for (int32_t pos = 0; pos < start; pos++) {
+        if (end - pos >= MIN_MATCH) chain_insert(&chains, pos);
+    }
+    size_t num_items = chunk_parse(&chains, start, end, items);
+
+    chunk->output = vec_construct_empty();
+    BITWRITER* writer = bwattach(chunk->output);
+    size_t block_start = start;
+    for (size_t first = 0; first < num_items || first == 0; first += BLOCK_ITEMS) {
+        size_t count = (num_items - first < BLOCK_ITEMS) ? num_items - first : BLOCK_ITEMS;
+        size_t block_end = block_start;
+        for (size_t i = first; i < first + count; i++) {
+            block_end += items[i].distance ? items[i].length : 1;
+        }
+        encoder_write_block(writer, items + first, count, (const char*) chains.data + block_start, block_end - block_start,
+                            chunk->final && first + count == num_items);
+        block_start = block_end;
+    }
+    if (!chunk->final) encoder_sync_flush(writer);
+    bwfree(writer);
+
+    free(items);
+    free(chains.head);
+    free(chains.prev);
+}
+
+size_t chunked_count(size_t size, size_t chunk_size) {
+    return size ? (size + chunk_size - 1) / chunk_size : 1;
+}
+
+void chunked_compress(BITWRITER* writer, const char* data, size_t size, size_t chunk_size, int independent, int threads,
+                      CHUNK_INDEX* index) {
+    size_t num_chunks = chunked_count(size, chunk_size);
+    CHUNK* chunks = calloc(num_chunks, sizeof(CHUNK));
+    for (size_t i = 0; i < num_chunks; i++) {
+        chunks[i].data = data;
+        chunks[i].start = i * chunk_size;
+        chunks[i].end = (i + 1 < num_chunks) ? (i + 1) * chunk_size : size;
+        chunks[i].final = (i + 1 == num_chunks);
+        chunks[i].independent = independent;
+    }
+
+    workqueue_run(chunks, num_chunks, sizeof(CHUNK), compress_chunk, threads);
+
+    for (size_t i = 0; i < num_chunks; i++) {
+        if (index) {
+            index[i].uncompressed_offset = chunks[i].start;
+            index[i].uncompressed_size = chunks[i].end - chunks[i].start;
+            index[i].compressed_offset = bwtell(writer) / 8;
+            index[i].compressed_size = vec_size(chunks[i].output);
+        }
+        bwappend(writer, vec_data(chunks[i].output), 8 * vec_size(chunks[i].output));
+        vec_free(chunks[i].output);
+    }
+    free(chunks);
+}
\ No newline at end of file
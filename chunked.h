@@ -0,0 +1,32 @@
+#ifndef CHUNKED_H
+#define CHUNKED_H
+
+#include "bitwriter.h"
+#include "deflate.h"
+#include <stddef.h>
+
+/**
+ * Returns the number of chunks that chunked_compress() splits an input into.
+ * 
+ * @param size: the number of bytes to compress
+ * @param chunk_size: the number of bytes per chunk
+ * @returns the number of chunks, which is 1 for an empty input
+ */
+size_t chunked_count(size_t size, size_t chunk_size);
+
+/**
+ * Compresses data into a raw DEFLATE stream, one fixed-size chunk per work item, with lazy hash chain matching.
+ * The bit writer must be on a byte boundary.
+ * 
+ * @param writer: the bit writer to write the stream to
+ * @param data: the data to compress
+ * @param size: the number of bytes to compress
+ * @param chunk_size: the number of bytes per chunk
+ * @param independent: 1 to keep matches from reaching into the previous chunk, 0 otherwise
+ * @param threads: the number of threads to use (at least 1)
+ * @param index: array of chunked_count() entries to fill in, or NULL
+ */
+void chunked_compress(BITWRITER* writer, const char* data, size_t size, size_t chunk_size, int independent, int threads,
+                      CHUNK_INDEX* index);
+
+#endif
\ No newline at end of file
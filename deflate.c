@@ -1,11 +1,27 @@
 #include "bitreader.h"
+#include "bitwriter.h"
+#include "checksum.h"
+#include "chunked.h"
 #include "deflate.h"
 #include "huffman.h"
+#include "optimal.h"
+#include <stdint.h>
 #include <stdlib.h>
 
-#define BTYPE_STORE 0
-#define BTYPE_FIXED_HUFFMAN 1
-#define BTYPE_DYNAMIC_HUFFMAN 2
+#define GZIP_ID1 0x1F
+#define GZIP_ID2 0x8B
+#define GZIP_FHCRC 0x02
+#define GZIP_FEXTRA 0x04
+#define GZIP_FNAME 0x08
+#define GZIP_FCOMMENT 0x10
+#define GZIP_FRESERVED 0xE0
+#define GZIP_XFL_SLOWEST 2
+#define GZIP_OS_UNKNOWN 255
+#define ZLIB_FDICT 0x20
+#define ZLIB_FLEVEL_DEFAULT 0x80
+#define ZLIB_FLEVEL_MAXIMUM 0xC0
+#define ZLIB_CMF 0x78  // DEFLATE with a 32 KiB window
+#define CM_DEFLATE 8
 
 // Fixed Huffman trees
 
@@ -50,41 +66,24 @@ const int base_lengths[29] = { 3,   4,   5,   6,   7,   8,   9,  10,  11,  13,
                               27,  31,  35,  43,  51,  59,  67,  83,  99, 115, 131, 163, 195, 227, 258};
 
 /**
- * Decodes the dynamic huffman trees from the bit reader.
+ * Private function to decode the run-length encoded code lengths of a dynamic block into its two trees.
  * 
  * @param reader: the bit reader
+ * @param nested_tree: the code length tree
+ * @param hlit: the number of literal-length codes minus 257
+ * @param hdist: the number of distance codes minus 1
  * @param tree_ll: pointer to the literal-length tree to read into
  * @param tree_d: pointer to the distance tree to read into
  * 
  * @return 1 on success, 0 otherwise
 */
-int decode_dynamic_trees(BITREADER* reader, HUFFMAN_TREE* tree_ll, HUFFMAN_TREE* tree_d) {
-    // First, decode the nested tree
-    HUFFMAN_TREE nested_tree = {{0}, {0}, {NULL}};
-    int hlit = brreadbits(reader, 5);
-    if (hlit == EOF) return 0;
-    int hdist = brreadbits(reader, 5);
-    if (hdist == EOF) return 0;
-    int hclen = brreadbits(reader, 4);
-    if (hclen == EOF) return 0;
-
-    int tree_values[19] = {0};
-    for (int i = 0; i < hclen + 4; i++) {
-        int length_of_code = brreadbits(reader, 3);
-        if (length_of_code == EOF) return 0;
-        tree_values[dynamic_tree_order[i]] = length_of_code;
-    }
-    for (int i = 0; i < 19; i++) {
-        huffman_add_symbol(&nested_tree, i, tree_values[i]);
-    }
-    if (!huffman_calculate_min_codewords(&nested_tree)) return 0;
-
+int decode_code_lengths(BITREADER* reader, const HUFFMAN_TREE nested_tree, int hlit, int hdist, HUFFMAN_TREE* tree_ll, HUFFMAN_TREE* tree_d) {
     int prev_length;
     int i = 0;
     while (i < hlit + hdist + 258) {
         int symbol = huffman_read_codeword(reader, nested_tree);
         if (symbol < 0) return 0;
-        if (symbol < 15) {
+        if (symbol < 16) {
             prev_length = symbol;
             huffman_add_symbol((i < hlit + 257) ? tree_ll : tree_d, (i < hlit + 257) ? i : i - hlit - 257, symbol);
             i++;
@@ -122,6 +121,45 @@ int decode_dynamic_trees(BITREADER* reader, HUFFMAN_TREE* tree_ll, HUFFMAN_TREE*
     return huffman_calculate_min_codewords(tree_ll) && huffman_calculate_min_codewords(tree_d);
 }
 
+/**
+ * Decodes the dynamic huffman trees from the bit reader.
+ * 
+ * @param reader: the bit reader
+ * @param tree_ll: pointer to the literal-length tree to read into
+ * @param tree_d: pointer to the distance tree to read into
+ * @param info: the block's description, which receives the number of codes in each tree
+ * 
+ * @return 1 on success, 0 otherwise
+*/
+int decode_dynamic_trees(BITREADER* reader, HUFFMAN_TREE* tree_ll, HUFFMAN_TREE* tree_d, BLOCK_INFO* info) {
+    // First, decode the nested tree
+    HUFFMAN_TREE nested_tree = {{0}, {0}, {NULL}};
+    int hlit = brreadbits(reader, 5);
+    if (hlit == EOF) return 0;
+    int hdist = brreadbits(reader, 5);
+    if (hdist == EOF) return 0;
+    int hclen = brreadbits(reader, 4);
+    if (hclen == EOF) return 0;
+    info->num_ll_codes = hlit + 257;
+    info->num_d_codes = hdist + 1;
+
+    int tree_values[19] = {0};
+    for (int i = 0; i < hclen + 4; i++) {
+        int length_of_code = brreadbits(reader, 3);
+        if (length_of_code == EOF) return 0;
+        tree_values[dynamic_tree_order[i]] = length_of_code;
+    }
+    for (int i = 0; i < 19; i++) {
+        huffman_add_symbol(&nested_tree, i, tree_values[i]);
+    }
+    int result = huffman_calculate_min_codewords(&nested_tree)
+                 && decode_code_lengths(reader, nested_tree, hlit, hdist, tree_ll, tree_d);
+    for (int i = 0; i < 16; i++) {
+        free(nested_tree.symbol[i]);
+    }
+    return result;
+}
+
 /**
  * Decodes a Huffman-coded message from a bit reader into a vector.
  * 
@@ -129,15 +167,20 @@ int decode_dynamic_trees(BITREADER* reader, HUFFMAN_TREE* tree_ll, HUFFMAN_TREE*
  * @param vector: the vector to read into
  * @param tree_ll: the literal-length Huffman tree
  * @param tree_d: the distance Huffman tree
+ * @param info: the block's description, which receives the literal and match counts
  * @returns 1 on success, 0 otherwise
 */
-int huffman_decode(BITREADER* reader, VECTOR* vector, const HUFFMAN_TREE tree_ll, const HUFFMAN_TREE tree_d) {
+int huffman_decode(BITREADER* reader, VECTOR* vector, const HUFFMAN_TREE tree_ll, const HUFFMAN_TREE tree_d, BLOCK_INFO* info) {
     while(1) {
         int symbol = huffman_read_codeword(reader, tree_ll);
         if (symbol == -1) return 0;
-        else if (symbol < 256) vec_push_back(vector, (char) symbol);  // literal
+        else if (symbol < 256) {  // literal
+            vec_push_back(vector, (char) symbol);
+            ++info->literals;
+        }
         else if (symbol == 256) return 1;  // end of block
         else if (symbol < 286) {  // length
+            ++info->matches;
             int extra_length = brreadbits(reader, extra_length_bits[symbol - 257]);
             if (extra_length == EOF) return 0;
             int length = base_lengths[symbol - 257] + extra_length;
@@ -164,15 +207,19 @@ int huffman_decode(BITREADER* reader, VECTOR* vector, const HUFFMAN_TREE tree_ll
  *
  * @param reader: the bit reader
  * @param vector: the vector to push to
+ * @param info: the block's description, which is filled in as the block is decoded
  * @returns 0 if the decompressor should inflate the next block,
  *          1 if the final block was successful,
  *         -1 if an error was encountered
  */
-int inflate_block(BITREADER* reader, VECTOR* vector) {
+int inflate_block(BITREADER* reader, VECTOR* vector, BLOCK_INFO* info) {
     int final = brreadbits(reader, 1);
+    if (final == EOF) return -1;
     int size, size_c, result;
     HUFFMAN_TREE tree_ll = {{0}, {0}, {0}}, tree_d = {{0}, {0}, {0}};
-    switch(brreadbits(reader, 2)) {
+    info->final = final;
+    info->type = brreadbits(reader, 2);
+    switch(info->type) {
         case BTYPE_STORE:
             size = brread_uint16(reader);
             if (size == EOF) return -1;
@@ -186,11 +233,11 @@ int inflate_block(BITREADER* reader, VECTOR* vector) {
             }
             break;
         case BTYPE_FIXED_HUFFMAN:
-            if (!huffman_decode(reader, vector, fixed_tree_ll, fixed_tree_d)) return -1;
+            if (!huffman_decode(reader, vector, fixed_tree_ll, fixed_tree_d, info)) return -1;
             break;
         case BTYPE_DYNAMIC_HUFFMAN:
-            result = decode_dynamic_trees(reader, &tree_ll, &tree_d);
-            if (result) result = huffman_decode(reader, vector, tree_ll, tree_d);
+            result = decode_dynamic_trees(reader, &tree_ll, &tree_d, info);
+            if (result) result = huffman_decode(reader, vector, tree_ll, tree_d, info);
             for (int i = 0; i < 16; i++) {
                 free(tree_ll.symbol[i]);
                 free(tree_d.symbol[i]);
@@ -203,19 +250,145 @@ int inflate_block(BITREADER* reader, VECTOR* vector) {
     return final;
 }
 
-VECTOR* inflate(FILE* stream) {
-    BITREADER* br = brattach(stream);
-    VECTOR* vec = vec_construct_empty();
+/**
+ * Private function to inflate a complete DEFLATE stream from a bit reader into a vector.
+ * On success, the rest of the last byte read is discarded, so the next byte read is the first one after the stream.
+ * 
+ * @param reader: the bit reader
+ * @param vector: the vector to push to
+ * @param member: the index of the gzip member being inflated, reported to the callback
+ * @param callback: function to call after each block, or NULL
+ * @param context: pointer passed to the callback
+ * @returns 1 on success, 0 otherwise
+ */
+int inflate_stream(BITREADER* reader, VECTOR* vector, int member, BLOCK_CALLBACK callback, void* context) {
     int result;
+    int index = 0;
     do {
-        result = inflate_block(br, vec);
+        BLOCK_INFO info = {0};
+        info.member = member;
+        info.index = index++;
+        info.input_bit_offset = brtell(reader);
+        info.output_offset = vec_size(vector);
+        result = inflate_block(reader, vector, &info);
+        if (result == -1) return 0;
+        info.input_bits = brtell(reader) - info.input_bit_offset;
+        info.output_size = vec_size(vector) - info.output_offset;
+        if (callback) callback(&info, context);
     } while(!result);
-    brfree(br);
-    if (result == -1) {
-        vec_free(vec);
-        return NULL;
+    reader->offset = 0;
+    return 1;
+}
+
+/**
+ * Private function to read a 32-bit integer from a bit reader, starting at the next byte boundary.
+ * 
+ * @param reader: the bit reader
+ * @param big_endian: 1 if the most significant byte comes first, 0 otherwise
+ * @param value: pointer to write the integer to
+ * @returns 1 on success, or 0 if EOF was reached
+ */
+int read_uint32(BITREADER* reader, int big_endian, uint32_t* value) {
+    *value = 0;
+    for (int i = 0; i < 4; i++) {
+        int byte = brread_uint8(reader);
+        if (byte == EOF) return 0;
+        *value |= (uint32_t) byte << (big_endian ? 24 - 8 * i : 8 * i);
     }
-    return vec;
+    return 1;
+}
+
+/**
+ * Private function to skip a zero-terminated string in a gzip header.
+ * 
+ * @param reader: the bit reader
+ * @returns 1 on success, or 0 if EOF was reached
+ */
+int skip_string(BITREADER* reader) {
+    int byte;
+    do {
+        byte = brread_uint8(reader);
+        if (byte == EOF) return 0;
+    } while (byte);
+    return 1;
+}
+
+/**
+ * Private function to read and validate a gzip member header.
+ * The optional header CRC is skipped without being checked.
+ * 
+ * @param reader: the bit reader
+ * @returns 1 on success, 0 otherwise
+ */
+int read_gzip_header(BITREADER* reader) {
+    if (brread_uint8(reader) != GZIP_ID1 || brread_uint8(reader) != GZIP_ID2) return 0;
+    if (brread_uint8(reader) != CM_DEFLATE) return 0;
+    int flags = brread_uint8(reader);
+    if (flags == EOF || flags & GZIP_FRESERVED) return 0;
+    for (int i = 0; i < 6; i++) {  // MTIME, XFL and OS
+        if (brread_uint8(reader) == EOF) return 0;
+    }
+    if (flags & GZIP_FEXTRA) {
+        int size = brread_uint16(reader);
+        if (size == EOF) return 0;
+        for (int i = 0; i < size; i++) {
+            if (brread_uint8(reader) == EOF) return 0;
+        }
+    }
+    if ((flags & GZIP_FNAME) && !skip_string(reader)) return 0;
+    if ((flags & GZIP_FCOMMENT) && !skip_string(reader)) return 0;
+    if ((flags & GZIP_FHCRC) && brread_uint16(reader) == EOF) return 0;
+    return 1;
+}
+
+/**
+ * Private function to inflate one or more concatenated gzip members into a vector.
+ * Anything after the last member that doesn't start like another one, such as zero padding, is ignored.
+ * 
+ * @param reader: the bit reader
+ * @param vector: the vector to push to
+ * @param callback: function to call after each block, or NULL
+ * @param context: pointer passed to the callback
+ * @returns 1 on success, 0 otherwise
+ */
+int inflate_gzip(BITREADER* reader, VECTOR* vector, BLOCK_CALLBACK callback, void* context) {
+    int member = 0;
+    do {
+        size_t start = vec_size(vector);
+        uint32_t crc, isize;
+        if (!read_gzip_header(reader)) return 0;
+        if (!inflate_stream(reader, vector, member++, callback, context)) return 0;
+        if (!read_uint32(reader, 0, &crc) || !read_uint32(reader, 0, &isize)) return 0;
+        if (crc != checksum_crc32(0, vec_data(vector) + start, vec_size(vector) - start)) return 0;
+        if (isize != (uint32_t) (vec_size(vector) - start)) return 0;
+    } while (brpeek_uint8(reader) == GZIP_ID1);
+    return 1;
+}
+
+/**
+ * Private function to inflate a zlib stream into a vector.
+ * Streams that require a preset dictionary are rejected.
+ * 
+ * @param reader: the bit reader
+ * @param vector: the vector to push to
+ * @param callback: function to call after each block, or NULL
+ * @param context: pointer passed to the callback
+ * @returns 1 on success, 0 otherwise
+ */
+int inflate_zlib(BITREADER* reader, VECTOR* vector, BLOCK_CALLBACK callback, void* context) {
+    int cmf = brread_uint8(reader);
+    int flg = brread_uint8(reader);
+    uint32_t adler;
+    if (cmf == EOF || flg == EOF) return 0;
+    if ((cmf & 0x0F) != CM_DEFLATE || (cmf >> 4) > 7 || (cmf * 256 + flg) % 31) return 0;
+    if (flg & ZLIB_FDICT) return 0;
+    if (!inflate_stream(reader, vector, 0, callback, context)) return 0;
+    if (!read_uint32(reader, 1, &adler)) return 0;
+    return adler == checksum_adler32(1, vec_data(vector), vec_size(vector));
+}
+
+VECTOR* inflate(FILE* stream) {
+    return inflate_format(stream, FORMAT_RAW, NULL, NULL);
 }
 
 int inflate_to_file(FILE* input_stream, FILE* output_stream) {
@@ -224,4 +397,148 @@ int inflate_to_file(FILE* input_stream, FILE* output_stream) {
     int result = fwrite(vec_data(inflated), 1, vec_size(inflated), output_stream) == vec_size(inflated);
     vec_free(inflated);
     return result;
+}
+
+int inflate_detect_format(FILE* stream) {
+    int first = fgetc(stream);
+    if (first == EOF) return EOF;
+    ungetc(first, stream);
+    // A raw stream can't start with 0x1F (BTYPE 3 is reserved), and only starts with a zlib-like CMF byte
+    // if it opens with a stored block with non-zero padding bits.
+    if (first == GZIP_ID1) return FORMAT_GZIP;
+    if ((first & 0x0F) == CM_DEFLATE && (first >> 4) <= 7) return FORMAT_ZLIB;
+    return FORMAT_RAW;
+}
+
+VECTOR* inflate_format(FILE* stream, int format, BLOCK_CALLBACK callback, void* context) {
+    if (format == FORMAT_AUTO) format = inflate_detect_format(stream);
+    if (format == EOF) return NULL;
+    BITREADER* br = brattach(stream);
+    if (!br) return NULL;
+    VECTOR* vec = vec_construct_empty();
+    int result;
+    switch (format) {
+        case FORMAT_RAW:
+            result = inflate_stream(br, vec, 0, callback, context);
+            break;
+        case FORMAT_ZLIB:
+            result = inflate_zlib(br, vec, callback, context);
+            break;
+        case FORMAT_GZIP:
+            result = inflate_gzip(br, vec, callback, context);
+            break;
+        default:
+            result = 0;
+    }
+    brfree(br);
+    if (!result) {
+        vec_free(vec);
+        return NULL;
+    }
+    return vec;
+}
+
+/**
+ * Private function to write a 32-bit integer to a bit writer, starting at the next byte boundary.
+ * 
+ * @param writer: the bit writer
+ * @param big_endian: 1 to write the most significant byte first, 0 otherwise
+ * @param value: the integer to write
+ */
+void write_uint32(BITWRITER* writer, int big_endian, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        bwwrite_uint8(writer, value >> (big_endian ? 24 - 8 * i : 8 * i));
+    }
+}
+
+/**
+ * Private function to write the header of a zlib or gzip stream.
+ * 
+ * @param writer: the bit writer
+ * @param format: one of the FORMAT_ constants
+ * @param slowest: 1 to record in the header that the slowest compression method was used, 0 otherwise
+ */
+void write_header(BITWRITER* writer, int format, int slowest) {
+    if (format == FORMAT_ZLIB) {
+        int flg = slowest ? ZLIB_FLEVEL_MAXIMUM : ZLIB_FLEVEL_DEFAULT;
+        flg += (31 - (ZLIB_CMF * 256 + flg) % 31) % 31;
+        bwwrite_uint8(writer, ZLIB_CMF);
+        bwwrite_uint8(writer, flg);
+    } else if (format == FORMAT_GZIP) {
+        bwwrite_uint8(writer, GZIP_ID1);
+        bwwrite_uint8(writer, GZIP_ID2);
+        bwwrite_uint8(writer, CM_DEFLATE);
+        bwwrite_uint8(writer, 0);       // FLG
+        write_uint32(writer, 0, 0);     // MTIME
+        bwwrite_uint8(writer, slowest ? GZIP_XFL_SLOWEST : 0);
+        bwwrite_uint8(writer, GZIP_OS_UNKNOWN);
+    }
+}
+
+/**
+ * Private function to write the trailer of a zlib or gzip stream.
+ * 
+ * @param writer: the bit writer
+ * @param format: one of the FORMAT_ constants
+ * @param data: the uncompressed data
+ * @param size: the number of uncompressed bytes
+ */
+void write_trailer(BITWRITER* writer, int format, const char* data, size_t size) {
+    if (format == FORMAT_ZLIB) {
+        write_uint32(writer, 1, checksum_adler32(1, data, size));
+    } else if (format == FORMAT_GZIP) {
+        write_uint32(writer, 0, checksum_crc32(0, data, size));
+        write_uint32(writer, 0, size);
+    }
+}
+
+VECTOR* inflate_chunk(FILE* stream, const char* dictionary, size_t dictionary_size) {
+    BITREADER* br = brattach(stream);
+    if (!br) return NULL;
+    VECTOR* vec = vec_construct_empty();
+    for (size_t i = 0; i < dictionary_size; i++) {
+        vec_push_back(vec, dictionary[i]);
+    }
+    int result = 0;
+    do {
+        BLOCK_INFO info = {0};
+        result = inflate_block(br, vec, &info);
+    } while (!result && brpeek_uint8(br) != EOF);
+    brfree(br);
+    if (result == -1) {
+        vec_free(vec);
+        return NULL;
+    }
+    VECTOR* chunk = vec_construct_capacity(vec_size(vec) - dictionary_size);
+    for (size_t i = dictionary_size; i < vec_size(vec); i++) {
+        vec_push_back(chunk, vec_at(vec, i));
+    }
+    vec_free(vec);
+    return chunk;
+}
+
+VECTOR* deflate_optimal(const char* data, size_t size, int format, int threads) {
+    if (format != FORMAT_RAW && format != FORMAT_ZLIB && format != FORMAT_GZIP) return NULL;
+    VECTOR* vec = vec_construct_empty();
+    BITWRITER* bw = bwattach(vec);
+    write_header(bw, format, 1);
+    optimal_compress(bw, data, size, threads);
+    write_trailer(bw, format, data, size);
+    return bwfree(bw);
+}
+
+VECTOR* deflate_parallel(const char* data, size_t size, int format, size_t chunk_size, int independent, int threads,
+                         CHUNK_INDEX** index, size_t* num_chunks) {
+    if (format != FORMAT_RAW && format != FORMAT_ZLIB && format != FORMAT_GZIP) return NULL;
+    if (!chunk_size) return NULL;
+    size_t count = chunked_count(size, chunk_size);
+    CHUNK_INDEX* entries = index ? calloc(count, sizeof(CHUNK_INDEX)) : NULL;
+    VECTOR* vec = vec_construct_empty();
+    BITWRITER* bw = bwattach(vec);
+    write_header(bw, format, 0);
+    chunked_compress(bw, data, size, chunk_size, independent, threads, entries);
+    write_trailer(bw, format, data, size);
+    if (index) *index = entries;
+    if (num_chunks) *num_chunks = count;
+    return bwfree(bw);
 }
\ No newline at end of file
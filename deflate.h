@@ -4,6 +4,52 @@
 #include "vector.h"
 #include <stdio.h>
 
+#define BTYPE_STORE 0
+#define BTYPE_FIXED_HUFFMAN 1
+#define BTYPE_DYNAMIC_HUFFMAN 2
+
+#define FORMAT_AUTO 0   // detect the container from the first byte of the stream
+#define FORMAT_RAW 1    // bare DEFLATE data (RFC 1951)
+#define FORMAT_ZLIB 2   // zlib wrapper with an Adler-32 trailer (RFC 1950)
+#define FORMAT_GZIP 3   // one or more gzip members with CRC-32 trailers (RFC 1952)
+
+/**
+ * Describes the structure of a single DEFLATE block, as reported to a BLOCK_CALLBACK.
+ */
+typedef struct __BLOCK_INFO {
+    int member;                 // index of the gzip member containing the block (always 0 for raw and zlib data)
+    int index;                  // index of the block within its member
+    int type;                   // BTYPE_STORE, BTYPE_FIXED_HUFFMAN or BTYPE_DYNAMIC_HUFFMAN
+    int final;                  // 1 if the block has the BFINAL bit set, 0 otherwise
+    int num_ll_codes;           // HLIT + 257 for dynamic blocks, 0 otherwise
+    int num_d_codes;            // HDIST + 1 for dynamic blocks, 0 otherwise
+    size_t input_bit_offset;    // position of the block header in the input stream, in bits
+    size_t input_bits;          // size of the block in the input stream, including its header
+    size_t output_offset;       // position of the block's first decoded byte in the output
+    size_t output_size;         // number of bytes decoded from the block
+    size_t literals;            // number of literal symbols decoded from the block
+    size_t matches;             // number of length-distance pairs decoded from the block
+} BLOCK_INFO;
+
+/**
+ * Describes where one chunk written by deflate_parallel() lies in the input and in the compressed output.
+ * Every chunk starts on a byte boundary, and every chunk except the last ends with an empty stored block.
+ */
+typedef struct __CHUNK_INDEX {
+    size_t uncompressed_offset;
+    size_t uncompressed_size;
+    size_t compressed_offset;   // position of the chunk's first block in the output, after any zlib or gzip header
+    size_t compressed_size;
+} CHUNK_INDEX;
+
+/**
+ * Function called after each block has been inflated.
+ * 
+ * @param block: the structure of the block that was just decoded
+ * @param context: the pointer that was passed along with the callback
+ */
+typedef void (*BLOCK_CALLBACK)(const BLOCK_INFO* block, void* context);
+
 /**
  * Decompresses a file with the DEFLATE algorithm and writes its output to a vector.
  * 
@@ -21,4 +67,73 @@ VECTOR* inflate(FILE* stream);
 */
 int inflate_to_file(FILE* input_stream, FILE* output_stream);
 
+/**
+ * Guesses the container format of a compressed stream from its first byte, without consuming it.
+ * A raw stream is reported unless the byte is a gzip magic number or a valid zlib CMF byte.
+ * 
+ * @param stream: the file stream to inspect
+ * @returns FORMAT_RAW, FORMAT_ZLIB or FORMAT_GZIP, or EOF if the stream is empty
+ */
+int inflate_detect_format(FILE* stream);
+
+/**
+ * Decompresses a raw, zlib or gzip stream and writes its output to a vector.
+ * Checksums and sizes in zlib and gzip trailers are verified, and concatenated gzip members are
+ * inflated one after another into the same vector.
+ * 
+ * @param stream: the file stream to inflate
+ * @param format: one of the FORMAT_ constants
+ * @param callback: function to call after each block, or NULL
+ * @param context: pointer passed to every call of the callback
+ * @returns a vector with the inflated content, or NULL if the content could not be inflated
+ */
+VECTOR* inflate_format(FILE* stream, int format, BLOCK_CALLBACK callback, void* context);
+
+/**
+ * Decompresses a single chunk written by deflate_parallel, starting at its compressed offset in the index.
+ * Unlike inflate_format, the stream may end right after a non-final block, such as the empty stored block of a
+ * sync flush, so it should hold only the chunk's compressed bytes. A chunk that was not compressed independently
+ * needs the (up to) 32 KiB of uncompressed data before it as a dictionary.
+ * 
+ * @param stream: the file stream to inflate, holding raw DEFLATE blocks
+ * @param dictionary: the uncompressed data before the chunk, or NULL
+ * @param dictionary_size: the number of bytes in the dictionary
+ * @returns a vector with the inflated chunk, without the dictionary, or NULL if it could not be inflated
+ */
+VECTOR* inflate_chunk(FILE* stream, const char* dictionary, size_t dictionary_size);
+
+/**
+ * Compresses data into a raw, zlib or gzip stream with slow, near-optimal parsing, for data that is
+ * compressed once and stored for a long time. Matches are found with binary trees, each block is parsed
+ * several times against the Huffman code lengths of the previous parse, and blocks are split wherever that
+ * lowers the estimated output size. The input is compressed in 1 MiB segments on parallel threads, each
+ * seeing the 32 KiB of input before it.
+ * 
+ * @param data: the data to compress
+ * @param size: the number of bytes to compress
+ * @param format: FORMAT_RAW, FORMAT_ZLIB or FORMAT_GZIP
+ * @param threads: the number of threads to use (at least 1)
+ * @returns a vector with the compressed content, or NULL if the format is invalid
+ */
+VECTOR* deflate_optimal(const char* data, size_t size, int format, int threads);
+
+/**
+ * Compresses data quickly into a raw, zlib or gzip stream, splitting it into fixed-size chunks that are
+ * compressed on separate threads, as pigz does. Each chunk is normally primed with the last 32 KiB of the
+ * chunk before it, and ends with a sync flush, so the chunks concatenate into a single stream. A single
+ * chunk can be inflated from its index entry with inflate_chunk.
+ * 
+ * @param data: the data to compress
+ * @param size: the number of bytes to compress
+ * @param format: FORMAT_RAW, FORMAT_ZLIB or FORMAT_GZIP
+ * @param chunk_size: the number of input bytes per chunk (at least 1)
+ * @param independent: 1 to compress every chunk without a dictionary, so that inflate_chunk needs none
+ * @param threads: the number of threads to use (at least 1)
+ * @param index: pointer to receive an array with an entry for each chunk, which must be freed later, or NULL
+ * @param num_chunks: pointer to receive the number of chunks, or NULL
+ * @returns a vector with the compressed content, or NULL if the format or chunk size is invalid
+ */
+VECTOR* deflate_parallel(const char* data, size_t size, int format, size_t chunk_size, int independent, int threads,
+                         CHUNK_INDEX** index, size_t* num_chunks);
+
 #endif
\ No newline at end of file
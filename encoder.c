@@ -0,0 +1,293 @@
+#include "deflate.h"
+#include "encoder.h"
+#include "huffman.h"
+#include <string.h>
+
+#define NUM_CL_SYMBOLS 19
+#define MAX_CL_CODEWORD_LENGTH 7
+#define MAX_STORED_SIZE 65535
+
+// Tables shared with the decoder in deflate.c
+
+extern const int dynamic_tree_order[19];
+extern const int extra_length_bits[29];
+extern const int base_lengths[29];
+
+/**
+ * Codewords for one block, along with the run-length encoded code lengths that make up a dynamic block header.
+ */
+typedef struct __BLOCK_CODES {
+    int ll_lengths[288];
+    int ll_codes[288];
+    int d_lengths[NUM_D_SYMBOLS];
+    int d_codes[NUM_D_SYMBOLS];
+    int num_ll;                                         // HLIT + 257
+    int num_d;                                          // HDIST + 1
+    int cl_lengths[NUM_CL_SYMBOLS];
+    int cl_codes[NUM_CL_SYMBOLS];
+    int num_cl;                                         // HCLEN + 4
+    uint8_t rle[NUM_LL_SYMBOLS + NUM_D_SYMBOLS];        // code-length symbols
+    uint8_t rle_extra[NUM_LL_SYMBOLS + NUM_D_SYMBOLS];  // extra bits of each code-length symbol
+    int num_rle;
+} BLOCK_CODES;
+
+int encoder_length_symbol(int length) {
+    int i = 28;
+    while (base_lengths[i] > length) i--;
+    return 257 + i;
+}
+
+int encoder_length_extra_bits(int symbol) {
+    return extra_length_bits[symbol - 257];
+}
+
+int encoder_distance_symbol(int distance) {
+    int x = distance - 1;
+    if (x < 4) return x;
+    int n = 31 - __builtin_clz(x);
+    return 2 * n + ((x >> (n - 1)) & 1);
+}
+
+int encoder_distance_extra_bits(int symbol) {
+    return (symbol >= 2) ? symbol / 2 - 1 : 0;
+}
+
+uint32_t encoder_hash3(const uint8_t* bytes, int bits) {
+    uint32_t value = bytes[0] | (bytes[1] << 8) | (bytes[2] << 16);
+    return (value * 2654435761u) >> (32 - bits);
+}
+
+/**
+ * Private function to compute the smallest distance encoded by a distance symbol.
+ * 
+ * @param symbol: the distance symbol (0-29)
+ * @returns the base distance
+ */
+int base_distance(int symbol) {
+    return (symbol >= 2) ? ((2 + symbol % 2) << (symbol / 2 - 1)) + 1 : symbol + 1;
+}
+
+void encoder_count(const LZ77_ITEM* items, size_t num_items, SYMBOL_COUNTS* counts) {
+    memset(counts, 0, sizeof(SYMBOL_COUNTS));
+    for (size_t i = 0; i < num_items; i++) {
+        if (items[i].distance) {
+            ++counts->ll[encoder_length_symbol(items[i].length)];
+            ++counts->d[encoder_distance_symbol(items[i].distance)];
+        } else {
+            ++counts->ll[items[i].length];
+        }
+    }
+    ++counts->ll[END_OF_BLOCK];
+}
+
+/**
+ * Private function to fill in the codewords of a fixed Huffman block.
+ * 
+ * @param codes: pointer to the codes to fill in
+ */
+void build_fixed_codes(BLOCK_CODES* codes) {
+    for (int i = 0; i < 288; i++) {
+        codes->ll_lengths[i] = (i < 144) ? 8 : (i < 256) ? 9 : (i < 280) ? 7 : 8;
+    }
+    for (int i = 0; i < NUM_D_SYMBOLS; i++) {
+        codes->d_lengths[i] = 5;
+    }
+    codes->num_ll = 288;
+    codes->num_d = NUM_D_SYMBOLS;
+    huffman_build_codes(codes->ll_lengths, 288, codes->ll_codes);
+    huffman_build_codes(codes->d_lengths, NUM_D_SYMBOLS, codes->d_codes);
+}
+
+/**
+ * Private function to append a code-length symbol to a dynamic block header.
+ * 
+ * @param codes: the codes being built
+ * @param symbol: the code-length symbol (0-18)
+ * @param extra: the value of its extra bits
+ */
+void push_rle(BLOCK_CODES* codes, int symbol, int extra) {
+    codes->rle[codes->num_rle] = symbol;
+    codes->rle_extra[codes->num_rle++] = extra;
+}
+
+/**
+ * Private function to build the codewords and header of a dynamic Huffman block.
+ * 
+ * @param counts: the symbol counts of the block
+ * @param codes: pointer to the codes to fill in
+ * @returns the size of the block header in bits, including BFINAL and BTYPE
+ */
+size_t build_dynamic_codes(const SYMBOL_COUNTS* counts, BLOCK_CODES* codes) {
+    huffman_build_lengths(counts->ll, NUM_LL_SYMBOLS, MAX_CODEWORD_LENGTH, codes->ll_lengths);
+    huffman_build_lengths(counts->d, NUM_D_SYMBOLS, MAX_CODEWORD_LENGTH, codes->d_lengths);
+    codes->num_ll = NUM_LL_SYMBOLS;
+    while (codes->num_ll > 257 && !codes->ll_lengths[codes->num_ll - 1]) codes->num_ll--;
+    codes->num_d = NUM_D_SYMBOLS;
+    while (codes->num_d > 1 && !codes->d_lengths[codes->num_d - 1]) codes->num_d--;
+    huffman_build_codes(codes->ll_lengths, codes->num_ll, codes->ll_codes);
+    huffman_build_codes(codes->d_lengths, codes->num_d, codes->d_codes);
+
+    // Run-length encode both code length sequences as one, since runs may cross from one to the other
+    int lengths[NUM_LL_SYMBOLS + NUM_D_SYMBOLS];
+    int n = codes->num_ll + codes->num_d;
+    memcpy(lengths, codes->ll_lengths, codes->num_ll * sizeof(int));
+    memcpy(lengths + codes->num_ll, codes->d_lengths, codes->num_d * sizeof(int));
+    codes->num_rle = 0;
+    for (int i = 0; i < n;) {
+        int value = lengths[i], run = 1;
+        while (i + run < n && lengths[i + run] == value) run++;
+        i += run;
+        if (!value) {
+            for (; run >= 11; run -= (run < 138) ? run : 138) {
+                push_rle(codes, 18, ((run < 138) ? run : 138) - 11);
+            }
+            if (run >= 3) {
+                push_rle(codes, 17, run - 3);
+                run = 0;
+            }
+        } else {
+            push_rle(codes, value, 0);
+            for (--run; run >= 3; run -= (run < 6) ? run : 6) {
+                push_rle(codes, 16, ((run < 6) ? run : 6) - 3);
+            }
+        }
+        for (; run > 0; run--) {
+            push_rle(codes, value, 0);
+        }
+    }
+
+    size_t cl_counts[NUM_CL_SYMBOLS] = {0};
+    for (int i = 0; i < codes->num_rle; i++) {
+        ++cl_counts[codes->rle[i]];
+    }
+    huffman_build_lengths(cl_counts, NUM_CL_SYMBOLS, MAX_CL_CODEWORD_LENGTH, codes->cl_lengths);
+    huffman_build_codes(codes->cl_lengths, NUM_CL_SYMBOLS, codes->cl_codes);
+    codes->num_cl = NUM_CL_SYMBOLS;
+    while (codes->num_cl > 4 && !codes->cl_lengths[dynamic_tree_order[codes->num_cl - 1]]) codes->num_cl--;
+
+    size_t bits = 3 + 5 + 5 + 4 + 3 * codes->num_cl;
+    for (int i = 0; i < codes->num_rle; i++) {
+        int symbol = codes->rle[i];
+        bits += codes->cl_lengths[symbol] + ((symbol == 16) ? 2 : (symbol == 17) ? 3 : (symbol == 18) ? 7 : 0);
+    }
+    return bits;
+}
+
+/**
+ * Private function to compute the size of a block's symbols (but not its header) with the given codes.
+ * 
+ * @param counts: the symbol counts of the block
+ * @param codes: the codes of the block
+ * @returns the size in bits
+ */
+size_t symbol_bits(const SYMBOL_COUNTS* counts, const BLOCK_CODES* codes) {
+    size_t bits = 0;
+    for (int i = 0; i < NUM_LL_SYMBOLS; i++) {
+        bits += counts->ll[i] * (codes->ll_lengths[i] + ((i > END_OF_BLOCK) ? encoder_length_extra_bits(i) : 0));
+    }
+    for (int i = 0; i < NUM_D_SYMBOLS; i++) {
+        bits += counts->d[i] * (codes->d_lengths[i] + encoder_distance_extra_bits(i));
+    }
+    return bits;
+}
+
+/**
+ * Private function to compute the size of the stored blocks needed for some data.
+ * 
+ * @param size: the number of bytes to store
+ * @param padding: the number of padding bits after the first block header
+ * @returns the size in bits
+ */
+size_t stored_bits(size_t size, int padding) {
+    size_t num_blocks = size ? (size + MAX_STORED_SIZE - 1) / MAX_STORED_SIZE : 1;
+    return num_blocks * (3 + 32) + (num_blocks - 1) * 5 + padding + 8 * size;
+}
+
+size_t encoder_block_bits(const SYMBOL_COUNTS* counts, size_t size) {
+    BLOCK_CODES codes;
+    size_t dynamic = build_dynamic_codes(counts, &codes) + symbol_bits(counts, &codes);
+    build_fixed_codes(&codes);
+    size_t fixed = 3 + symbol_bits(counts, &codes);
+    size_t stored = stored_bits(size, 5);
+    size_t best = (dynamic < fixed) ? dynamic : fixed;
+    return (stored < best) ? stored : best;
+}
+
+/**
+ * Private function to write the symbols of a block, followed by the end-of-block symbol.
+ * 
+ * @param writer: the bit writer
+ * @param items: the items of the block
+ * @param num_items: the number of items
+ * @param codes: the codes of the block
+ */
+void write_symbols(BITWRITER* writer, const LZ77_ITEM* items, size_t num_items, const BLOCK_CODES* codes) {
+    for (size_t i = 0; i < num_items; i++) {
+        if (!items[i].distance) {
+            bwwritebits(writer, codes->ll_codes[items[i].length], codes->ll_lengths[items[i].length]);
+            continue;
+        }
+        int length_symbol = encoder_length_symbol(items[i].length);
+        bwwritebits(writer, codes->ll_codes[length_symbol], codes->ll_lengths[length_symbol]);
+        bwwritebits(writer, items[i].length - base_lengths[length_symbol - 257], encoder_length_extra_bits(length_symbol));
+        int distance_symbol = encoder_distance_symbol(items[i].distance);
+        bwwritebits(writer, codes->d_codes[distance_symbol], codes->d_lengths[distance_symbol]);
+        bwwritebits(writer, items[i].distance - base_distance(distance_symbol), encoder_distance_extra_bits(distance_symbol));
+    }
+    bwwritebits(writer, codes->ll_codes[END_OF_BLOCK], codes->ll_lengths[END_OF_BLOCK]);
+}
+
+void encoder_write_block(BITWRITER* writer, const LZ77_ITEM* items, size_t num_items, const char* data, size_t size, int final) {
+    SYMBOL_COUNTS counts;
+    BLOCK_CODES dynamic_codes, fixed_codes;
+    encoder_count(items, num_items, &counts);
+    size_t dynamic = build_dynamic_codes(&counts, &dynamic_codes) + symbol_bits(&counts, &dynamic_codes);
+    build_fixed_codes(&fixed_codes);
+    size_t fixed = 3 + symbol_bits(&counts, &fixed_codes);
+    size_t stored = stored_bits(size, (8 - (bwtell(writer) + 3) % 8) % 8);
+
+    if (stored < dynamic && stored < fixed) {
+        size_t offset = 0;
+        do {
+            size_t length = (size - offset < MAX_STORED_SIZE) ? size - offset : MAX_STORED_SIZE;
+            bwwritebits(writer, final && offset + length == size, 1);
+            bwwritebits(writer, BTYPE_STORE, 2);
+            bwwrite_uint16(writer, length);
+            bwwrite_uint16(writer, ~length);
+            for (size_t i = 0; i < length; i++) {
+                bwwrite_uint8(writer, data[offset + i]);
+            }
+            offset += length;
+        } while (offset < size);
+    } else if (fixed <= dynamic) {
+        bwwritebits(writer, final, 1);
+        bwwritebits(writer, BTYPE_FIXED_HUFFMAN, 2);
+        write_symbols(writer, items, num_items, &fixed_codes);
+    } else {
+        bwwritebits(writer, final, 1);
+        bwwritebits(writer, BTYPE_DYNAMIC_HUFFMAN, 2);
+        bwwritebits(writer, dynamic_codes.num_ll - 257, 5);
+        bwwritebits(writer, dynamic_codes.num_d - 1, 5);
+        bwwritebits(writer, dynamic_codes.num_cl - 4, 4);
+        for (int i = 0; i < dynamic_codes.num_cl; i++) {
+            bwwritebits(writer, dynamic_codes.cl_lengths[dynamic_tree_order[i]], 3);
+        }
+        for (int i = 0; i < dynamic_codes.num_rle; i++) {
+            int symbol = dynamic_codes.rle[i];
+            bwwritebits(writer, dynamic_codes.cl_codes[symbol], dynamic_codes.cl_lengths[symbol]);
+            if (symbol >= 16) bwwritebits(writer, dynamic_codes.rle_extra[i], (symbol == 16) ? 2 : (symbol == 17) ? 3 : 7);
+        }
+        write_symbols(writer, items, num_items, &dynamic_codes);
+    }
+}
+
+void encoder_sync_flush(BITWRITER* writer) {
+    bwwritebits(writer, 0, 1);
+    bwwritebits(writer, BTYPE_STORE, 2);
+    bwwrite_uint16(writer, 0);
+    bwwrite_uint16(writer, 0xFFFF);
+}
+
+void encoder_align(BITWRITER* writer) {
+    if (bwtell(writer) % 8) encoder_sync_flush(writer);
+}
\ No newline at end of file
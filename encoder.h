@@ -0,0 +1,120 @@
+#ifndef ENCODER_H
+#define ENCODER_H
+
+#include "bitwriter.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define WINDOW_SIZE 32768
+#define MIN_MATCH 3
+#define MAX_MATCH 258
+#define NUM_LL_SYMBOLS 286
+#define NUM_D_SYMBOLS 30
+#define END_OF_BLOCK 256
+#define MAX_CODEWORD_LENGTH 15
+
+/**
+ * A single LZ77 symbol: either a literal byte or a back-reference.
+ */
+typedef struct __LZ77_ITEM {
+    uint16_t length;    // match length, or the literal byte if distance is 0
+    uint16_t distance;  // match distance, or 0 for a literal
+} LZ77_ITEM;
+
+/**
+ * Symbol frequencies of a block, including its end-of-block symbol.
+ */
+typedef struct __SYMBOL_COUNTS {
+    size_t ll[NUM_LL_SYMBOLS];
+    size_t d[NUM_D_SYMBOLS];
+} SYMBOL_COUNTS;
+
+/**
+ * Hashes the 3 bytes at a position, for match finders that index positions by their first MIN_MATCH bytes.
+ * 
+ * @param bytes: pointer to at least 3 bytes
+ * @param bits: the number of bits in the hash (1-32)
+ * @returns the hash
+ */
+uint32_t encoder_hash3(const uint8_t* bytes, int bits);
+
+/**
+ * Returns the literal-length symbol that encodes a match length.
+ * 
+ * @param length: the match length (3-258)
+ * @returns the symbol (257-285)
+ */
+int encoder_length_symbol(int length);
+
+/**
+ * Returns the number of extra bits that follow a literal-length symbol.
+ * 
+ * @param symbol: a length symbol (257-285)
+ * @returns the number of extra bits
+ */
+int encoder_length_extra_bits(int symbol);
+
+/**
+ * Returns the distance symbol that encodes a match distance.
+ * 
+ * @param distance: the match distance (1-32768)
+ * @returns the symbol (0-29)
+ */
+int encoder_distance_symbol(int distance);
+
+/**
+ * Returns the number of extra bits that follow a distance symbol.
+ * 
+ * @param symbol: a distance symbol (0-29)
+ * @returns the number of extra bits
+ */
+int encoder_distance_extra_bits(int symbol);
+
+/**
+ * Counts the symbols needed to encode some LZ77 items as a block, including the end-of-block symbol.
+ * 
+ * @param items: the items of the block
+ * @param num_items: the number of items
+ * @param counts: pointer to the counts to overwrite
+ */
+void encoder_count(const LZ77_ITEM* items, size_t num_items, SYMBOL_COUNTS* counts);
+
+/**
+ * Estimates the size of a block, using the cheapest of the three block types.
+ * Stored blocks are assumed to need a full byte of padding.
+ * 
+ * @param counts: the symbol counts of the block
+ * @param size: the number of bytes the block decodes to
+ * @returns the size of the block in bits, including its header
+ */
+size_t encoder_block_bits(const SYMBOL_COUNTS* counts, size_t size);
+
+/**
+ * Writes LZ77 items as one DEFLATE block, using the cheapest of the three block types.
+ * A stored block longer than 65535 bytes is written as several blocks.
+ * 
+ * @param writer: the bit writer
+ * @param items: the items of the block
+ * @param num_items: the number of items
+ * @param data: the bytes the items decode to, used for stored blocks
+ * @param size: the number of bytes the items decode to
+ * @param final: 1 to set the BFINAL bit, 0 otherwise
+ */
+void encoder_write_block(BITWRITER* writer, const LZ77_ITEM* items, size_t num_items, const char* data, size_t size, int final);
+
+/**
+ * Writes an empty, non-final stored block, which leaves the bit writer on a byte boundary.
+ * This is what zlib writes for Z_SYNC_FLUSH, and the 00 00 FF FF it ends with marks a point where inflating can resume.
+ * 
+ * @param writer: the bit writer
+ */
+void encoder_sync_flush(BITWRITER* writer);
+
+/**
+ * Writes an empty, non-final stored block if the bit writer is not on a byte boundary, so that it is afterwards.
+ * 
+ * @param writer: the bit writer
+ */
+void encoder_align(BITWRITER* writer);
+
+#endif
\ No newline at end of file
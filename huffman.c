@@ -30,4 +30,110 @@ void huffman_add_symbol(HUFFMAN_TREE* tree, int symbol, int length) {
     ++tree->num_symbols[length];
     tree->symbol[length] = reallocarray(tree->symbol[length], tree->num_symbols[length], sizeof(int));
     tree->symbol[length][tree->num_symbols[length] - 1] = symbol;
+}
+
+/**
+ * Private comparison function to sort symbol indices by increasing frequency, then by symbol.
+ */
+int compare_leaves(const void* a, const void* b) {
+    const size_t* left = a;
+    const size_t* right = b;
+    if (left[0] != right[0]) return (left[0] < right[0]) ? -1 : 1;
+    return (left[1] < right[1]) ? -1 : (left[1] > right[1]);
+}
+
+void huffman_build_lengths(const size_t* frequencies, int num_symbols, int max_length, int* lengths) {
+    // Each leaf is a (frequency, symbol) pair so that qsort can order ties deterministically
+    size_t (*leaves)[2] = malloc(num_symbols * sizeof(*leaves));
+    int num_leaves = 0;
+    for (int i = 0; i < num_symbols; i++) {
+        lengths[i] = 0;
+        if (frequencies[i]) {
+            leaves[num_leaves][0] = frequencies[i];
+            leaves[num_leaves++][1] = i;
+        }
+    }
+    for (int i = 0; i < num_symbols && num_leaves < 2; i++) {
+        if (!frequencies[i]) {
+            leaves[num_leaves][0] = 0;
+            leaves[num_leaves++][1] = i;
+        }
+    }
+    qsort(leaves, num_leaves, sizeof(*leaves), compare_leaves);
+
+    // Build the tree with two queues: sorted leaves, and internal nodes, which are created in increasing weight
+    size_t* weight = malloc(2 * num_symbols * sizeof(size_t));
+    int* parent = malloc(2 * num_symbols * sizeof(int));
+    int* depth = malloc(2 * num_symbols * sizeof(int));
+    for (int i = 0; i < num_leaves; i++) {
+        weight[i] = leaves[i][0];
+    }
+    int next_leaf = 0, next_node = num_leaves;
+    for (int node = num_leaves; node < 2 * num_leaves - 1; node++) {
+        weight[node] = 0;
+        for (int child = 0; child < 2; child++) {
+            int smallest = (next_leaf < num_leaves && (next_node == node || weight[next_leaf] <= weight[next_node]))
+                           ? next_leaf++ : next_node++;
+            weight[node] += weight[smallest];
+            parent[smallest] = node;
+        }
+    }
+    depth[2 * num_leaves - 2] = 0;
+    for (int node = 2 * num_leaves - 3; node >= 0; node--) {
+        depth[node] = depth[parent[node]] + 1;
+    }
+
+    // Clamp the lengths, then lengthen or shorten codewords until the Kraft sum is exactly 1
+    int count[16] = {0};
+    for (int i = 0; i < num_leaves; i++) {
+        ++count[depth[i] > max_length ? max_length : depth[i]];
+    }
+    long kraft = 0, target = 1L << max_length;
+    for (int length = 1; length <= max_length; length++) {
+        kraft += (long) count[length] << (max_length - length);
+    }
+    while (kraft > target) {
+        int length = max_length - 1;
+        while (!count[length]) length--;
+        --count[length];
+        ++count[length + 1];
+        kraft -= 1L << (max_length - length - 1);
+    }
+    while (kraft < target) {
+        int length = max_length;
+        while (!count[length] || (1L << (max_length - length)) > target - kraft) length--;
+        --count[length];
+        ++count[length - 1];
+        kraft += 1L << (max_length - length);
+    }
+
+    // The least frequent symbols get the longest codewords
+    int leaf = 0;
+    for (int length = max_length; length > 0; length--) {
+        for (int i = 0; i < count[length]; i++) {
+            lengths[leaves[leaf++][1]] = length;
+        }
+    }
+    free(leaves);
+    free(weight);
+    free(parent);
+    free(depth);
+}
+
+void huffman_build_codes(const int* lengths, int num_symbols, int* codes) {
+    int count[16] = {0}, next_code[16] = {0};
+    for (int i = 0; i < num_symbols; i++) {
+        ++count[lengths[i]];
+    }
+    count[0] = 0;
+    for (int length = 1; length < 16; length++) {
+        next_code[length] = (next_code[length - 1] + count[length - 1]) << 1;
+    }
+    for (int i = 0; i < num_symbols; i++) {
+        int code = next_code[lengths[i]]++, reversed = 0;
+        for (int bit = 0; bit < lengths[i]; bit++) {
+            reversed |= ((code >> bit) & 1) << (lengths[i] - 1 - bit);
+        }
+        codes[i] = reversed;
+    }
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 #define HUFFMAN_H
 
 #include "bitreader.h"
+#include <stddef.h>
 
 /**
  * Structure for storing a canonical Huffman tree.
@@ -42,4 +43,26 @@ int huffman_calculate_min_codewords(HUFFMAN_TREE* tree);
 */
 void huffman_add_symbol(HUFFMAN_TREE* tree, int symbol, int length);
 
+/**
+ * Computes length-limited Huffman codeword lengths for the given symbol frequencies.
+ * Symbols with a frequency of 0 get a length of 0. The code is always complete, as DEFLATE decoders expect:
+ * if fewer than two symbols are used, the first unused symbols are given codewords as well.
+ * 
+ * @param frequencies: the frequency of each symbol
+ * @param num_symbols: the number of symbols (at least 2)
+ * @param max_length: the maximum codeword length (at most 15)
+ * @param lengths: array to write each symbol's codeword length to
+ */
+void huffman_build_lengths(const size_t* frequencies, int num_symbols, int max_length, int* lengths);
+
+/**
+ * Computes the canonical codewords for a set of codeword lengths.
+ * The codewords are bit-reversed, so that they can be written least significant bit first.
+ * 
+ * @param lengths: the codeword length of each symbol, or 0 for unused symbols
+ * @param num_symbols: the number of symbols
+ * @param codes: array to write each symbol's codeword to
+ */
+void huffman_build_codes(const int* lengths, int num_symbols, int* codes);
+
 #endif
\ No newline at end of file
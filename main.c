@@ -0,0 +1,690 @@
+/*
+ * Command-line front end for the inflater and the optimal and parallel compressors.
+ * Build with: cc -O2 -pthread *.c -o deflate
+ */
+
+#define _GNU_SOURCE
+#include "deflate.h"
+#include "vector.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#define PROGRAM_NAME "deflate"
+#define READ_CHUNK 65536
+#define DEFAULT_CHUNK_SIZE (128 * 1024)
+
+#define COMPRESS_OPTIMAL 1
+#define COMPRESS_PARALLEL 2
+
+const char* usage =
+    "usage: " PROGRAM_NAME " [-d|-z|-p] [-cft] [-j N] [--format=auto|raw|zlib|gzip] [--bench] [--stats]\n"
+    "               [--chunk SIZE] [--independent] [--index] [--extract N] [file...]\n"
+    "Decompresses each file (or standard input if none is given) to the file name without its suffix,\n"
+    "or compresses it to the file name with a suffix added.\n"
+    "\n"
+    "  -d, --decompress  decompress (the default)\n"
+    "  -z, --compress    compress with the slow, high-ratio mode\n"
+    "  -p, --parallel    compress quickly, in chunks that are compressed in parallel and concatenated\n"
+    "  -c, --stdout      write the output to standard output, in the order the files were given\n"
+    "  -f, --force       overwrite existing output files\n"
+    "  -t, --test        check the input without writing any output\n"
+    "  -j, --jobs N      decompress up to N files at once, or compress each file with N threads\n"
+    "      --format F    container: auto (the default; gzip when compressing), raw, zlib or gzip\n"
+    "      --bench       report sizes, per-phase times, throughput and peak memory on standard error\n"
+    "      --stats       report the structure of every DEFLATE block read or written on standard error\n"
+    "      --chunk SIZE  bytes per chunk for -p, optionally with a K or M suffix (default 128K)\n"
+    "      --independent don't prime each chunk with the end of the previous one, so --extract can inflate any chunk\n"
+    "      --index       with -p, also write the offsets of every chunk to the output file name plus .idx\n"
+    "      --extract N   decompress only chunk N (from 0) of a file written by -p --independent --index\n"
+    "  -h, --help        show this message\n";
+
+// Suffixes removed from input file names to get output file names when decompressing
+
+const char* suffixes[6][2] = {{".gz", ""}, {".tgz", ".tar"}, {".z", ""}, {".zz", ""}, {".zlib", ""}, {".deflate", ""}};
+
+const char* format_names[4] = {"auto", "raw", "zlib", "gzip"};
+
+// Suffixes added to input file names when compressing, for each format
+
+const char* format_suffixes[4] = {".gz", ".deflate", ".zz", ".gz"};
+
+const char* btype_names[3] = {"stored", "fixed", "dynamic"};
+
+/**
+ * Settings parsed from the command line.
+ */
+typedef struct __OPTIONS {
+    int compress;           // 0 to decompress, or COMPRESS_OPTIMAL or COMPRESS_PARALLEL
+    int to_stdout;
+    int force;
+    int test;
+    int bench;
+    int stats;
+    int format;
+    int jobs;
+    size_t chunk_size;
+    int independent;
+    int index;
+    long long extract;      // chunk to decompress, or -1 to decompress everything
+} OPTIONS;
+
+/**
+ * State of the decompression of a single input, shared between a worker thread and the main thread.
+ * Everything except done is written by the worker before done is set, and read by the main thread after.
+ */
+typedef struct __JOB {
+    const char* input_name;     // NULL for standard input
+    char* output_name;          // NULL when writing to standard output or testing
+    VECTOR* output;             // result, kept until the main thread writes it to standard output
+    const char* error;          // description of the failure, or NULL on success
+    int format;                 // container format that was inflated or deflated
+    size_t input_size;
+    size_t output_size;
+    double read_time;           // seconds spent reading the input
+    double coding_time;         // seconds spent inflating or deflating, including checksums
+    double write_time;          // seconds spent writing the output
+    CHUNK_INDEX* index;         // chunk offsets, collected only for --index
+    size_t num_chunks;
+    BLOCK_INFO* blocks;         // block structure, collected only for --stats
+    size_t num_blocks;
+    size_t blocks_capacity;
+    int done;
+} JOB;
+
+/**
+ * Work queue shared by the worker threads.
+ */
+typedef struct __QUEUE {
+    JOB* jobs;
+    size_t num_jobs;
+    size_t next;
+    const OPTIONS* options;
+    pthread_mutex_t lock;
+    pthread_cond_t finished;
+} QUEUE;
+
+/**
+ * Private function to read a monotonic clock.
+ *
+ * @returns the current time in seconds
+ */
+double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Private function to read an entire stream into memory.
+ *
+ * @param stream: the stream to read
+ * @param size: pointer to write the number of bytes read to
+ * @returns a buffer that must be freed later, or NULL if the stream could not be read
+ */
+char* read_all(FILE* stream, size_t* size) {
+    size_t capacity = READ_CHUNK;
+    char* buffer = malloc(capacity);
+    *size = 0;
+    while (1) {
+        if (*size == capacity) {
+            capacity *= 2;
+            buffer = realloc(buffer, capacity);
+        }
+        size_t count = fread(buffer + *size, 1, capacity - *size, stream);
+        *size += count;
+        if (count == 0) break;
+    }
+    if (ferror(stream)) {
+        free(buffer);
+        return NULL;
+    }
+    return buffer;
+}
+
+/**
+ * Private function to compute the output file name for an input file.
+ *
+ * @param input_name: the input file name
+ * @returns a string that must be freed later, or NULL if the name has no known suffix
+ */
+char* output_name_for(const char* input_name) {
+    size_t length = strlen(input_name);
+    for (size_t i = 0; i < sizeof(suffixes) / sizeof(suffixes[0]); i++) {
+        size_t suffix_length = strlen(suffixes[i][0]);
+        if (length <= suffix_length || strcasecmp(input_name + length - suffix_length, suffixes[i][0])) continue;
+        char* name = malloc(length - suffix_length + strlen(suffixes[i][1]) + 1);
+        memcpy(name, input_name, length - suffix_length);
+        strcpy(name + length - suffix_length, suffixes[i][1]);
+        return name;
+    }
+    return NULL;
+}
+
+/**
+ * Private BLOCK_CALLBACK that appends each block to a job's block list.
+ *
+ * @param block: the block that was decoded
+ * @param context: the job
+ */
+void collect_block(const BLOCK_INFO* block, void* context) {
+    JOB* job = context;
+    if (job->num_blocks == job->blocks_capacity) {
+        job->blocks_capacity = job->blocks_capacity ? job->blocks_capacity * 2 : 16;
+        job->blocks = reallocarray(job->blocks, job->blocks_capacity, sizeof(BLOCK_INFO));
+    }
+    job->blocks[job->num_blocks++] = *block;
+}
+
+/**
+ * Private function to write a job's output to a stream and time it.
+ *
+ * @param job: the job whose output to write
+ * @param stream: the stream to write to
+ * @returns 1 on success, 0 otherwise
+ */
+int write_output(JOB* job, FILE* stream) {
+    double start = now();
+    size_t size = vec_size(job->output);
+    int result = (!size || fwrite(vec_data(job->output), 1, size, stream) == size) && fflush(stream) == 0;
+    job->write_time = now() - start;
+    return result;
+}
+
+/**
+ * Private function to compute the output file name for an input file when compressing.
+ *
+ * @param input_name: the input file name
+ * @param format: the container format
+ * @returns a string that must be freed later, or NULL if the name already has a compressed suffix
+ */
+char* compressed_name_for(const char* input_name, int format) {
+    char* stripped = output_name_for(input_name);
+    if (stripped) {
+        free(stripped);
+        return NULL;
+    }
+    char* name = malloc(strlen(input_name) + strlen(format_suffixes[format]) + 1);
+    strcpy(name, input_name);
+    strcat(name, format_suffixes[format]);
+    return name;
+}
+
+/**
+ * Private function to get the name of the chunk index of a compressed file.
+ *
+ * @param compressed_name: the name of the compressed file
+ * @returns the name with .idx added, which must be freed later
+ */
+char* index_name_for(const char* compressed_name) {
+    char* name = malloc(strlen(compressed_name) + 5);
+    strcpy(name, compressed_name);
+    strcat(name, ".idx");
+    return name;
+}
+
+/**
+ * Private function to write a job's chunk index as text, one line per chunk.
+ *
+ * @param job: the job whose index to write
+ * @param independent: 1 if the chunks were compressed without dictionaries, 0 otherwise
+ * @returns 1 on success, 0 otherwise
+ */
+int write_index(const JOB* job, int independent) {
+    char* name = index_name_for(job->output_name);
+    FILE* stream = fopen(name, "w");
+    free(name);
+    if (!stream) return 0;
+    fprintf(stream, "# %s chunk index: format=%s independent=%d chunks=%zu\n", PROGRAM_NAME, format_names[job->format],
+            independent, job->num_chunks);
+    fprintf(stream, "# uncompressed_offset uncompressed_size compressed_offset compressed_size\n");
+    for (size_t i = 0; i < job->num_chunks; i++) {
+        fprintf(stream, "%zu %zu %zu %zu\n", job->index[i].uncompressed_offset, job->index[i].uncompressed_size,
+                job->index[i].compressed_offset, job->index[i].compressed_size);
+    }
+    return fclose(stream) == 0;
+}
+
+/**
+ * Private function to read one entry of the chunk index written next to a compressed file by --index.
+ *
+ * @param input_name: the name of the compressed file
+ * @param number: the chunk to look up, counting from 0
+ * @param entry: pointer to write the entry to
+ * @returns NULL on success, or a description of the failure
+ */
+const char* read_index(const char* input_name, size_t number, CHUNK_INDEX* entry) {
+    char* name = index_name_for(input_name);
+    FILE* stream = fopen(name, "r");
+    free(name);
+    if (!stream) return "cannot open index";
+    const char* error = NULL;
+    int independent;
+    size_t num_chunks;
+    if (fscanf(stream, "# " PROGRAM_NAME " chunk index: format=%*s independent=%d chunks=%zu", &independent,
+               &num_chunks) != 2) {
+        error = "invalid index";
+    } else if (!independent) {
+        error = "chunks were not compressed with --independent";
+    } else if (number >= num_chunks) {
+        error = "no such chunk in the index";
+    }
+    // Skip the rest of the first line and the column names
+    for (int lines = 0; !error && lines < 2;) {
+        int c = fgetc(stream);
+        if (c == EOF) error = "invalid index";
+        else if (c == '\n') lines++;
+    }
+    for (size_t i = 0; !error && i <= number; i++) {
+        if (fscanf(stream, "%zu %zu %zu %zu", &entry->uncompressed_offset, &entry->uncompressed_size,
+                   &entry->compressed_offset, &entry->compressed_size) != 4) {
+            error = "invalid index";
+        }
+    }
+    fclose(stream);
+    return error;
+}
+
+/**
+ * Private function to inflate the chunk of the input given by --extract.
+ *
+ * @param job: the job, whose input name is set
+ * @param data: the compressed input
+ * @param number: the chunk to inflate, counting from 0
+ */
+void extract_chunk(JOB* job, char* data, size_t number) {
+    CHUNK_INDEX entry;
+    job->error = read_index(job->input_name, number, &entry);
+    if (job->error) return;
+    if (entry.compressed_offset > job->input_size || entry.compressed_size > job->input_size - entry.compressed_offset) {
+        job->error = "index does not match the input";
+        return;
+    }
+    job->format = FORMAT_RAW;
+    FILE* memory = fmemopen(data + entry.compressed_offset, entry.compressed_size, "rb");
+    job->output = inflate_chunk(memory, NULL, 0);
+    if (memory) fclose(memory);
+    if (!job->output || vec_size(job->output) != entry.uncompressed_size) {
+        vec_free(job->output);
+        job->output = NULL;
+        job->error = "invalid or corrupt compressed data";
+    }
+}
+
+/**
+ * Private function to read, inflate or deflate, and (unless writing to standard output) write a single input.
+ *
+ * @param job: the job to run
+ * @param options: the command-line settings
+ */
+void run_job(JOB* job, const OPTIONS* options) {
+    FILE* input = job->input_name ? fopen(job->input_name, "rb") : stdin;
+    if (!input) {
+        job->error = "cannot open input";
+        return;
+    }
+    double start = now();
+    char* input_data = read_all(input, &job->input_size);
+    job->read_time = now() - start;
+    if (job->input_name) fclose(input);
+    if (!input_data) {
+        job->error = "read error";
+        return;
+    }
+
+    if (options->compress) {
+        start = now();
+        job->format = (options->format == FORMAT_AUTO) ? FORMAT_GZIP : options->format;
+        if (options->compress == COMPRESS_PARALLEL) {
+            job->output = deflate_parallel(input_data, job->input_size, job->format, options->chunk_size,
+                                           options->independent, options->jobs, options->index ? &job->index : NULL,
+                                           &job->num_chunks);
+        } else {
+            job->output = deflate_optimal(input_data, job->input_size, job->format, options->jobs);
+        }
+        job->coding_time = now() - start;
+        free(input_data);
+        if (options->stats) {
+            // Describe the blocks that were written by decoding them again
+            FILE* memory = fmemopen((void*) vec_data(job->output), vec_size(job->output), "rb");
+            VECTOR* check = inflate_format(memory, job->format, collect_block, job);
+            fclose(memory);
+            vec_free(check);
+        }
+    } else {
+        if (job->input_size == 0) {
+            free(input_data);
+            job->error = "unexpected end of file";
+            return;
+        }
+        start = now();
+        if (options->extract >= 0) {
+            extract_chunk(job, input_data, options->extract);
+        } else {
+            FILE* memory = fmemopen(input_data, job->input_size, "rb");
+            job->format = (options->format == FORMAT_AUTO) ? inflate_detect_format(memory) : options->format;
+            job->output = inflate_format(memory, job->format, options->stats ? collect_block : NULL, job);
+            fclose(memory);
+            if (!job->output) job->error = "invalid or corrupt compressed data";
+        }
+        job->coding_time = now() - start;
+        free(input_data);
+        if (job->error) return;
+    }
+    job->output_size = vec_size(job->output);
+
+    if (job->output_name) {
+        FILE* output = fopen(job->output_name, "wb");
+        if (!output) {
+            job->error = "cannot create output file";
+        } else {
+            if (!write_output(job, output)) job->error = "write error";
+            if (fclose(output) && !job->error) job->error = "write error";
+        }
+        if (job->index && !job->error && !write_index(job, options->independent)) job->error = "cannot write index";
+    }
+    if (job->output_name || options->test) {
+        vec_free(job->output);
+        job->output = NULL;
+    }
+}
+
+/**
+ * Private thread entry point that runs jobs from the queue until it is empty.
+ *
+ * @param argument: the queue
+ * @returns NULL
+ */
+void* worker(void* argument) {
+    QUEUE* queue = argument;
+    while (1) {
+        pthread_mutex_lock(&queue->lock);
+        size_t index = queue->next++;
+        pthread_mutex_unlock(&queue->lock);
+        if (index >= queue->num_jobs) return NULL;
+        if (queue->jobs[index].done) continue;  // failed before any work started
+
+        run_job(&queue->jobs[index], queue->options);
+
+        pthread_mutex_lock(&queue->lock);
+        queue->jobs[index].done = 1;
+        pthread_cond_broadcast(&queue->finished);
+        pthread_mutex_unlock(&queue->lock);
+    }
+}
+
+/**
+ * Private function to print the block structure collected for a job.
+ *
+ * @param job: the finished job
+ * @param name: the name to print for the input
+ */
+void print_stats(const JOB* job, const char* name) {
+    fprintf(stderr, "%s: %s, %zu blocks\n", name, format_names[job->format], job->num_blocks);
+    fprintf(stderr, "%6s %6s %-7s %5s %12s %10s %12s %10s %9s %9s %5s %5s\n", "member", "block", "type", "final",
+            "bit_offset", "bits", "out_offset", "out_size", "literals", "matches", "nlit", "ndist");
+    for (size_t i = 0; i < job->num_blocks; i++) {
+        const BLOCK_INFO* block = &job->blocks[i];
+        fprintf(stderr, "%6d %6d %-7s %5d %12zu %10zu %12zu %10zu %9zu %9zu %5d %5d\n", block->member, block->index,
+                btype_names[block->type], block->final, block->input_bit_offset, block->input_bits,
+                block->output_offset, block->output_size, block->literals, block->matches, block->num_ll_codes,
+                block->num_d_codes);
+    }
+}
+
+/**
+ * Private function to print the benchmark figures for a job.
+ *
+ * @param job: the finished job
+ * @param name: the name to print for the input
+ * @param compress: 1 if the job compressed its input, 0 otherwise
+ */
+void print_bench(const JOB* job, const char* name, int compress) {
+    // Throughput is always measured on the uncompressed side
+    size_t uncompressed = compress ? job->input_size : job->output_size;
+    fprintf(stderr, "%s: %s, %zu -> %zu bytes (%.2fx), read %.3f ms, %s %.3f ms (%.1f MB/s), write %.3f ms\n",
+            name, format_names[job->format], job->input_size, job->output_size,
+            job->input_size ? (double) job->output_size / job->input_size : 0.0, job->read_time * 1e3,
+            compress ? "deflate" : "inflate", job->coding_time * 1e3,
+            job->coding_time > 0 ? uncompressed / job->coding_time / 1e6 : 0.0, job->write_time * 1e3);
+}
+
+/**
+ * Private function to parse the argument of --jobs.
+ *
+ * @param text: the argument, or NULL if it was missing
+ * @returns the number of jobs, or 0 if the argument is invalid
+ */
+int parse_jobs(const char* text) {
+    if (!text) return 0;
+    char* end;
+    long jobs = strtol(text, &end, 10);
+    if (*end || jobs < 1 || jobs > 1024) return 0;
+    return jobs;
+}
+
+/**
+ * Private function to parse the argument of --chunk.
+ *
+ * @param text: the argument, or NULL if it was missing
+ * @returns the number of bytes, or 0 if the argument is invalid
+ */
+size_t parse_size(const char* text) {
+    if (!text) return 0;
+    char* end;
+    unsigned long long size = strtoull(text, &end, 10);
+    int shift = 0;
+    if (*end == 'k' || *end == 'K') {
+        shift = 10;
+        end++;
+    } else if (*end == 'm' || *end == 'M') {
+        shift = 20;
+        end++;
+    }
+    // Check the limit before shifting, so that huge sizes can't wrap around
+    if (*end || text[0] == '-' || size > (1ULL << 30) >> shift) return 0;
+    return size << shift;
+}
+
+/**
+ * Private function to parse the argument of --format.
+ *
+ * @param text: the argument
+ * @returns one of the FORMAT_ constants, or -1 if the argument is invalid
+ */
+int parse_format(const char* text) {
+    for (int i = 0; i < 4; i++) {
+        if (!strcmp(text, format_names[i])) return i;
+    }
+    return -1;
+}
+
+int main(int argc, char** argv) {
+    OPTIONS options = {0, 0, 0, 0, 0, 0, FORMAT_AUTO, 1, DEFAULT_CHUNK_SIZE, 0, 0, -1};
+    int chunk_options = 0;
+    const char** names = calloc(argc, sizeof(char*));
+    size_t num_names = 0;
+    int end_of_options = 0;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        if (end_of_options || arg[0] != '-' || !strcmp(arg, "-")) {
+            names[num_names++] = strcmp(arg, "-") ? arg : NULL;
+        } else if (!strcmp(arg, "--")) {
+            end_of_options = 1;
+        } else if (!strcmp(arg, "--decompress")) {
+            options.compress = 0;
+        } else if (!strcmp(arg, "--compress")) {
+            options.compress = COMPRESS_OPTIMAL;
+        } else if (!strcmp(arg, "--parallel")) {
+            options.compress = COMPRESS_PARALLEL;
+        } else if (!strcmp(arg, "--independent")) {
+            options.independent = 1;
+            chunk_options = 1;
+        } else if (!strcmp(arg, "--index")) {
+            options.index = 1;
+            chunk_options = 1;
+        } else if (!strncmp(arg, "--extract", 9) && (arg[9] == '=' || !arg[9])) {
+            const char* value = arg[9] ? arg + 10 : (i + 1 < argc ? argv[++i] : "");
+            char* end;
+            options.extract = strtoll(value, &end, 10);
+            if (!*value || *end || options.extract < 0) {
+                fprintf(stderr, "%s: invalid chunk number\n", PROGRAM_NAME);
+                return 1;
+            }
+        } else if (!strncmp(arg, "--chunk", 7) && (arg[7] == '=' || !arg[7])) {
+            options.chunk_size = parse_size(arg[7] ? arg + 8 : (i + 1 < argc ? argv[++i] : NULL));
+            chunk_options = 1;
+            if (!options.chunk_size) {
+                fprintf(stderr, "%s: invalid chunk size\n", PROGRAM_NAME);
+                return 1;
+            }
+        } else if (!strcmp(arg, "--stdout")) {
+            options.to_stdout = 1;
+        } else if (!strcmp(arg, "--force")) {
+            options.force = 1;
+        } else if (!strcmp(arg, "--test")) {
+            options.test = 1;
+        } else if (!strcmp(arg, "--bench")) {
+            options.bench = 1;
+        } else if (!strcmp(arg, "--stats")) {
+            options.stats = 1;
+        } else if (!strcmp(arg, "--help")) {
+            fputs(usage, stdout);
+            return 0;
+        } else if (!strncmp(arg, "--jobs", 6) && (arg[6] == '=' || !arg[6])) {
+            options.jobs = parse_jobs(arg[6] ? arg + 7 : (i + 1 < argc ? argv[++i] : NULL));
+            if (!options.jobs) {
+                fprintf(stderr, "%s: invalid number of jobs\n", PROGRAM_NAME);
+                return 1;
+            }
+        } else if (!strncmp(arg, "--format", 8) && (arg[8] == '=' || !arg[8])) {
+            const char* value = arg[8] ? arg + 9 : (i + 1 < argc ? argv[++i] : "");
+            options.format = parse_format(value);
+            if (options.format < 0) {
+                fprintf(stderr, "%s: unknown format '%s'\n", PROGRAM_NAME, value);
+                return 1;
+            }
+        } else if (arg[1] == '-') {
+            fprintf(stderr, "%s: unknown option '%s'\n%s", PROGRAM_NAME, arg, usage);
+            return 1;
+        } else {
+            for (const char* flag = arg + 1; *flag; flag++) {
+                if (*flag == 'c') options.to_stdout = 1;
+                else if (*flag == 'f') options.force = 1;
+                else if (*flag == 't') options.test = 1;
+                else if (*flag == 'd') options.compress = 0;
+                else if (*flag == 'z') options.compress = COMPRESS_OPTIMAL;
+                else if (*flag == 'p') options.compress = COMPRESS_PARALLEL;
+                else if (*flag == 'h') {
+                    fputs(usage, stdout);
+                    return 0;
+                } else if (*flag == 'j') {
+                    options.jobs = parse_jobs(flag[1] ? flag + 1 : (i + 1 < argc ? argv[++i] : NULL));
+                    if (!options.jobs) {
+                        fprintf(stderr, "%s: invalid number of jobs\n", PROGRAM_NAME);
+                        return 1;
+                    }
+                    break;
+                } else {
+                    fprintf(stderr, "%s: unknown option '-%c'\n%s", PROGRAM_NAME, *flag, usage);
+                    return 1;
+                }
+            }
+        }
+    }
+    if (num_names == 0) names[num_names++] = NULL;
+    if (chunk_options && options.compress != COMPRESS_PARALLEL) {
+        fprintf(stderr, "%s: --chunk, --independent and --index only apply to -p\n", PROGRAM_NAME);
+        return 1;
+    }
+    if (options.extract >= 0 && options.compress) {
+        fprintf(stderr, "%s: --extract only applies to decompression\n", PROGRAM_NAME);
+        return 1;
+    }
+
+    // Work out every output name up front, so that errors are reported before any work starts
+    JOB* jobs = calloc(num_names, sizeof(JOB));
+    int status = 0;
+    for (size_t i = 0; i < num_names; i++) {
+        jobs[i].input_name = names[i];
+        if (!names[i] || options.to_stdout || options.test) {
+            if (options.index) jobs[i].error = "--index needs an output file, not standard output";
+            if (options.extract >= 0 && !names[i]) jobs[i].error = "--extract needs a file with an index, not standard input";
+            if (jobs[i].error) jobs[i].done = 1;
+            continue;
+        }
+        struct stat info;
+        if (options.compress) {
+            jobs[i].output_name = compressed_name_for(names[i], options.format);
+            if (!jobs[i].output_name) jobs[i].error = "already has a compressed suffix -- ignored";
+        } else {
+            jobs[i].output_name = output_name_for(names[i]);
+            if (!jobs[i].output_name) jobs[i].error = "unknown suffix -- ignored";
+        }
+        if (jobs[i].output_name && !options.force && stat(jobs[i].output_name, &info) == 0) {
+            jobs[i].error = "output file already exists (use -f to overwrite)";
+        }
+        if (jobs[i].output_name && options.index && !options.force && !jobs[i].error) {
+            char* index_name = index_name_for(jobs[i].output_name);
+            if (stat(index_name, &info) == 0) jobs[i].error = "index file already exists (use -f to overwrite)";
+            free(index_name);
+        }
+        if (jobs[i].error) jobs[i].done = 1;
+    }
+
+    QUEUE queue = {jobs, num_names, 0, &options, PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER};
+    // When compressing, the threads are spent inside each file instead
+    int num_threads = options.compress ? 1 : (options.jobs < (int) num_names) ? options.jobs : (int) num_names;
+    pthread_t* threads = calloc(num_threads, sizeof(pthread_t));
+    double start = now();
+    for (int i = 0; i < num_threads; i++) {
+        pthread_create(&threads[i], NULL, worker, &queue);
+    }
+
+    // Report (and write to standard output) in the order the inputs were given
+    size_t total_input = 0, total_output = 0, total_uncompressed = 0;
+    for (size_t i = 0; i < num_names; i++) {
+        JOB* job = &jobs[i];
+        pthread_mutex_lock(&queue.lock);
+        while (!job->done) pthread_cond_wait(&queue.finished, &queue.lock);
+        pthread_mutex_unlock(&queue.lock);
+
+        const char* name = names[i] ? names[i] : "(stdin)";
+        if (job->output && !job->error && !write_output(job, stdout)) job->error = "write error";
+        if (job->error) {
+            fprintf(stderr, "%s: %s: %s\n", PROGRAM_NAME, name, job->error);
+            status = 1;
+        } else {
+            if (options.stats) print_stats(job, name);
+            if (options.bench) print_bench(job, name, options.compress);
+            total_input += job->input_size;
+            total_output += job->output_size;
+            total_uncompressed += options.compress ? job->input_size : job->output_size;
+        }
+        vec_free(job->output);
+        free(job->output_name);
+        free(job->blocks);
+        free(job->index);
+    }
+    for (int i = 0; i < num_threads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    double elapsed = now() - start;
+
+    if (options.bench) {
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        fprintf(stderr, "total: %zu files, %zu -> %zu bytes, %d threads, wall %.3f ms (%.1f MB/s), peak memory %ld KiB\n",
+                num_names, total_input, total_output, options.compress ? options.jobs : num_threads, elapsed * 1e3,
+                elapsed > 0 ? total_uncompressed / elapsed / 1e6 : 0.0, usage.ru_maxrss);
+    }
+    free(threads);
+    free(jobs);
+    free(names);
+    return status;
+}
@@ -0,0 +1,415 @@
+#include "encoder.h"
+#include "huffman.h"
+#include "optimal.h"
+#include "workqueue.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SEGMENT_SIZE (1 << 20)  // bytes of input compressed by a thread at a time
+#define HASH_BITS 16
+#define MAX_SEARCH_DEPTH 128    // binary tree nodes visited per position
+#define MAX_ITERATIONS 10       // parses per block, each priced with the code lengths of the one before
+#define SPLIT_ITERATIONS 2      // parses of a whole segment before looking for block boundaries
+#define SPLIT_CANDIDATES 9      // split points tried per round when narrowing down the best one
+#define MIN_BLOCK_ITEMS 256     // fewest LZ77 items on each side of a split
+#define NO_NODE -1
+
+/**
+ * A match found by the match finder.
+ */
+typedef struct __MATCH {
+    uint16_t length;
+    uint16_t distance;
+} MATCH;
+
+/**
+ * Binary tree match finder: for each hash of 3 bytes, the positions seen so far form a binary search tree
+ * ordered by the strings that start there, with the most recent position at the root.
+ */
+typedef struct __MATCHFINDER {
+    const uint8_t* data;    // start of the segment's history
+    size_t size;            // number of bytes from data to the end of the segment
+    int32_t* head;          // root of the tree for each hash
+    int32_t* children;      // smaller (even index) and larger (odd index) child of each position
+} MATCHFINDER;
+
+/**
+ * Bit costs of every literal, match length and distance symbol, including extra bits.
+ */
+typedef struct __COST_MODEL {
+    uint32_t literal[256];
+    uint32_t length[MAX_MATCH + 1];
+    uint32_t distance[NUM_D_SYMBOLS];
+} COST_MODEL;
+
+/**
+ * A part of the input compressed independently by one thread, and the bits it was compressed to.
+ */
+typedef struct __SEGMENT {
+    const char* data;       // the whole input
+    size_t start;
+    size_t end;
+    int final;              // 1 if this is the last segment, which ends with the final block
+    VECTOR* output;
+    size_t bits;            // number of bits of output, a multiple of 8 unless the segment is final
+} SEGMENT;
+
+/**
+ * Working memory for compressing one segment. Positions are relative to the start of the segment's history.
+ */
+typedef struct __PARSER {
+    const uint8_t* data;    // start of the segment's history
+    size_t start;           // position of the first byte of the segment
+    size_t* match_offsets;  // index of the first cached match of each position of the segment, plus an end index
+    MATCH* matches;
+    size_t num_matches;
+    size_t matches_capacity;
+    uint32_t* cost;         // cost of the cheapest parse from each position to the end of the block
+    LZ77_ITEM* choice;      // first item of that parse
+    LZ77_ITEM* items;       // parse being evaluated
+    LZ77_ITEM* best_items;  // cheapest parse of the block so far
+    size_t num_best_items;
+} PARSER;
+
+/**
+ * Private function to insert a position into the match finder, and optionally collect its matches.
+ * Matches are reported with strictly increasing lengths.
+ *
+ * @param mf: the match finder
+ * @param cur: the position to insert, which must have at least MIN_MATCH bytes after it
+ * @param matches: array of at least MAX_SEARCH_DEPTH matches to write to, or NULL to only insert
+ * @returns the number of matches found
+ */
+int bt_advance(MATCHFINDER* mf, int32_t cur, MATCH* matches) {
+    const uint8_t* data = mf->data;
+    int max_length = (mf->size - cur < MAX_MATCH) ? mf->size - cur : MAX_MATCH;
+    uint32_t hash = encoder_hash3(data + cur, HASH_BITS);
+    int32_t node = mf->head[hash];
+    int32_t* pending_smaller = &mf->children[2 * cur];
+    int32_t* pending_larger = &mf->children[2 * cur + 1];
+    int smaller_length = 0, larger_length = 0, best_length = MIN_MATCH - 1, num_matches = 0;
+    mf->head[hash] = cur;
+
+    // Walk down the old tree, splitting it into the subtrees of strings smaller and larger than the new root
+    for (int depth = 0; node != NO_NODE && cur - node <= WINDOW_SIZE && depth < MAX_SEARCH_DEPTH; depth++) {
+        int length = (smaller_length < larger_length) ? smaller_length : larger_length;
+        while (length < max_length && data[node + length] == data[cur + length]) length++;
+        if (matches && length > best_length) {
+            best_length = length;
+            matches[num_matches].length = length;
+            matches[num_matches++].distance = cur - node;
+        }
+        if (length == max_length) {
+            // The old node can't be told apart from the new one, so the new one takes over its children
+            *pending_smaller = mf->children[2 * node];
+            *pending_larger = mf->children[2 * node + 1];
+            return num_matches;
+        }
+        if (data[node + length] < data[cur + length]) {
+            *pending_smaller = node;
+            pending_smaller = &mf->children[2 * node + 1];
+            node = *pending_smaller;
+            smaller_length = length;
+        } else {
+            *pending_larger = node;
+            pending_larger = &mf->children[2 * node];
+            node = *pending_larger;
+            larger_length = length;
+        }
+    }
+    *pending_smaller = NO_NODE;
+    *pending_larger = NO_NODE;
+    return num_matches;
+}
+
+/**
+ * Private function to find and cache the matches at every position of a segment.
+ *
+ * @param parser: the parser, whose data and start are set
+ * @param size: the number of bytes from the start of the history to the end of the segment
+ */
+void find_matches(PARSER* parser, size_t size) {
+    MATCHFINDER mf = {parser->data, size, malloc(sizeof(int32_t) << HASH_BITS), malloc(2 * size * sizeof(int32_t))};
+    MATCH found[MAX_SEARCH_DEPTH];
+    for (size_t i = 0; i < (1 << HASH_BITS); i++) {
+        mf.head[i] = NO_NODE;
+    }
+    for (size_t pos = 0; pos < size; pos++) {
+        int num_found = 0;
+        if (size - pos >= MIN_MATCH) num_found = bt_advance(&mf, pos, (pos >= parser->start) ? found : NULL);
+        if (pos < parser->start) continue;
+        parser->match_offsets[pos - parser->start] = parser->num_matches;
+        if (parser->num_matches + num_found > parser->matches_capacity) {
+            parser->matches_capacity = 2 * (parser->num_matches + num_found);
+            parser->matches = reallocarray(parser->matches, parser->matches_capacity, sizeof(MATCH));
+        }
+        if (!num_found) continue;
+        memcpy(parser->matches + parser->num_matches, found, num_found * sizeof(MATCH));
+        parser->num_matches += num_found;
+    }
+    parser->match_offsets[size - parser->start] = parser->num_matches;
+    free(mf.head);
+    free(mf.children);
+}
+
+/**
+ * Private function to fill in a cost model with the code lengths of a fixed Huffman block.
+ *
+ * @param model: the model to fill in
+ */
+void fixed_cost_model(COST_MODEL* model) {
+    for (int i = 0; i < 256; i++) {
+        model->literal[i] = (i < 144) ? 8 : 9;
+    }
+    for (int length = MIN_MATCH; length <= MAX_MATCH; length++) {
+        int symbol = encoder_length_symbol(length);
+        model->length[length] = ((symbol < 280) ? 7 : 8) + encoder_length_extra_bits(symbol);
+    }
+    for (int i = 0; i < NUM_D_SYMBOLS; i++) {
+        model->distance[i] = 5 + encoder_distance_extra_bits(i);
+    }
+}
+
+/**
+ * Private function to price symbols with the Huffman code lengths that a parse's symbol counts would get.
+ * Unused symbols are priced as if they occurred once.
+ *
+ * @param model: the model to fill in
+ * @param counts: the symbol counts of the parse
+ */
+void update_cost_model(COST_MODEL* model, const SYMBOL_COUNTS* counts) {
+    int ll_lengths[NUM_LL_SYMBOLS], d_lengths[NUM_D_SYMBOLS];
+    size_t ll_total = 0, d_total = 0;
+    huffman_build_lengths(counts->ll, NUM_LL_SYMBOLS, MAX_CODEWORD_LENGTH, ll_lengths);
+    huffman_build_lengths(counts->d, NUM_D_SYMBOLS, MAX_CODEWORD_LENGTH, d_lengths);
+    for (int i = 0; i < NUM_LL_SYMBOLS; i++) {
+        ll_total += counts->ll[i];
+    }
+    for (int i = 0; i < NUM_D_SYMBOLS; i++) {
+        d_total += counts->d[i];
+    }
+    int ll_unused = ll_total ? 64 - __builtin_clzll(ll_total) : 1;
+    int d_unused = d_total ? 64 - __builtin_clzll(d_total) : 1;
+    if (ll_unused > MAX_CODEWORD_LENGTH) ll_unused = MAX_CODEWORD_LENGTH;
+    if (d_unused > MAX_CODEWORD_LENGTH) d_unused = MAX_CODEWORD_LENGTH;
+
+    for (int i = 0; i < 256; i++) {
+        model->literal[i] = ll_lengths[i] ? ll_lengths[i] : ll_unused;
+    }
+    for (int length = MIN_MATCH; length <= MAX_MATCH; length++) {
+        int symbol = encoder_length_symbol(length);
+        model->length[length] = (ll_lengths[symbol] ? ll_lengths[symbol] : ll_unused) + encoder_length_extra_bits(symbol);
+    }
+    for (int i = 0; i < NUM_D_SYMBOLS; i++) {
+        model->distance[i] = (d_lengths[i] ? d_lengths[i] : d_unused) + encoder_distance_extra_bits(i);
+    }
+}
+
+/**
+ * Private function to find the cheapest parse of a block under a cost model, by dynamic programming
+ * from the end of the block back to its start.
+ *
+ * @param parser: the parser
+ * @param start: position of the first byte of the block
+ * @param end: position after the last byte of the block
+ * @param model: the cost model
+ * @returns the number of items written to parser->items
+ */
+size_t parse(PARSER* parser, size_t start, size_t end, const COST_MODEL* model) {
+    size_t size = end - start;
+    parser->cost[size] = 0;
+    for (size_t i = size; i-- > 0;) {
+        size_t pos = start + i;
+        uint8_t literal = parser->data[pos];
+        uint32_t best = parser->cost[i + 1] + model->literal[literal];
+        LZ77_ITEM choice = {literal, 0};
+        int limit = (size - i < MAX_MATCH) ? size - i : MAX_MATCH;
+        int previous = MIN_MATCH - 1;
+        const MATCH* match = parser->matches + parser->match_offsets[pos - parser->start];
+        const MATCH* last = parser->matches + parser->match_offsets[pos - parser->start + 1];
+        for (; match < last; match++) {
+            int length = (match->length < limit) ? match->length : limit;
+            uint32_t distance_cost = model->distance[encoder_distance_symbol(match->distance)];
+            for (int l = previous + 1; l <= length; l++) {
+                uint32_t cost = parser->cost[i + l] + model->length[l] + distance_cost;
+                if (cost < best) {
+                    best = cost;
+                    choice.length = l;
+                    choice.distance = match->distance;
+                }
+            }
+            if (length == limit) break;
+            previous = length;
+        }
+        parser->cost[i] = best;
+        parser->choice[i] = choice;
+    }
+
+    size_t num_items = 0;
+    for (size_t i = 0; i < size; i += parser->choice[i].distance ? parser->choice[i].length : 1) {
+        parser->items[num_items++] = parser->choice[i];
+    }
+    return num_items;
+}
+
+/**
+ * Private function to parse a block repeatedly, pricing each parse with the code lengths of the one before,
+ * until the estimated block size stops shrinking. The cheapest parse is left in parser->best_items.
+ *
+ * @param parser: the parser
+ * @param start: position of the first byte of the block
+ * @param end: position after the last byte of the block
+ * @param iterations: the maximum number of parses
+ * @returns the estimated size of the block in bits
+ */
+size_t parse_block(PARSER* parser, size_t start, size_t end, int iterations) {
+    COST_MODEL model;
+    SYMBOL_COUNTS counts;
+    size_t best_bits = SIZE_MAX;
+    fixed_cost_model(&model);
+    for (int i = 0; i < iterations; i++) {
+        size_t num_items = parse(parser, start, end, &model);
+        encoder_count(parser->items, num_items, &counts);
+        size_t bits = encoder_block_bits(&counts, end - start);
+        if (bits >= best_bits) break;
+        best_bits = bits;
+        memcpy(parser->best_items, parser->items, num_items * sizeof(LZ77_ITEM));
+        parser->num_best_items = num_items;
+        update_cost_model(&model, &counts);
+    }
+    return best_bits;
+}
+
+/**
+ * Private function to estimate the size of a range of items written as a single block.
+ *
+ * @param items: the items
+ * @param positions: the position of each item, with an extra entry after the last one
+ * @param start: index of the first item
+ * @param end: index after the last item
+ * @returns the estimated size in bits
+ */
+size_t range_bits(const LZ77_ITEM* items, const size_t* positions, size_t start, size_t end) {
+    SYMBOL_COUNTS counts;
+    encoder_count(items + start, end - start, &counts);
+    return encoder_block_bits(&counts, positions[end] - positions[start]);
+}
+
+/**
+ * Private function to split a range of items into blocks wherever that lowers their estimated total size.
+ * The best split point is searched for by evaluating evenly spaced candidates, then narrowing the search
+ * down to the neighbourhood of the best one. Split points are appended in increasing order.
+ *
+ * @param items: the items
+ * @param positions: the position of each item, with an extra entry after the last one
+ * @param start: index of the first item
+ * @param end: index after the last item
+ * @param splits: array to append split points (item indices) to
+ * @param num_splits: pointer to the number of split points in the array
+ */
+void split_blocks(const LZ77_ITEM* items, const size_t* positions, size_t start, size_t end, size_t* splits, size_t* num_splits) {
+    if (end - start < 2 * MIN_BLOCK_ITEMS) return;
+    size_t best_bits = range_bits(items, positions, start, end), best_split = 0;
+    size_t low = start + MIN_BLOCK_ITEMS, high = end - MIN_BLOCK_ITEMS;
+    while (low <= high) {
+        size_t step = (high - low) / (SPLIT_CANDIDATES + 1) + 1, best_candidate = 0, round_bits = SIZE_MAX;
+        for (size_t split = low; split <= high; split += step) {
+            size_t bits = range_bits(items, positions, start, split) + range_bits(items, positions, split, end);
+            if (bits < round_bits) {
+                round_bits = bits;
+                best_candidate = split;
+            }
+        }
+        if (round_bits < best_bits) {
+            best_bits = round_bits;
+            best_split = best_candidate;
+        }
+        if (step == 1) break;
+        low = (best_candidate > low + step) ? best_candidate - step : low;
+        high = (best_candidate + step < high) ? best_candidate + step : high;
+    }
+    if (!best_split) return;
+    split_blocks(items, positions, start, best_split, splits, num_splits);
+    splits[(*num_splits)++] = best_split;
+    split_blocks(items, positions, best_split, end, splits, num_splits);
+}
+
+/**
+ * Private function to compress one segment into its own bit vector.
+ *
+ * @param item: the segment to compress
+ */
+void compress_segment(void* item) {
+    SEGMENT* segment = item;
+    size_t history = (segment->start < WINDOW_SIZE) ? segment->start : WINDOW_SIZE;
+    size_t segment_size = segment->end - segment->start;
+    size_t size = history + segment_size;
+    PARSER parser = {0};
+    parser.data = (const uint8_t*) segment->data + segment->start - history;
+    parser.start = history;
+    parser.match_offsets = malloc((segment_size + 1) * sizeof(size_t));
+    parser.cost = malloc((segment_size + 1) * sizeof(uint32_t));
+    parser.choice = malloc((segment_size + 1) * sizeof(LZ77_ITEM));
+    parser.items = malloc((segment_size + 1) * sizeof(LZ77_ITEM));
+    parser.best_items = malloc((segment_size + 1) * sizeof(LZ77_ITEM));
+    find_matches(&parser, size);
+
+    // Choose block boundaries on a rough parse of the whole segment
+    parse_block(&parser, history, size, SPLIT_ITERATIONS);
+    size_t num_items = parser.num_best_items;
+    size_t* positions = malloc((num_items + 1) * sizeof(size_t));
+    size_t* splits = malloc((num_items / MIN_BLOCK_ITEMS + 2) * sizeof(size_t));
+    size_t num_splits = 0;
+    positions[0] = history;
+    for (size_t i = 0; i < num_items; i++) {
+        const LZ77_ITEM* item = &parser.best_items[i];
+        positions[i + 1] = positions[i] + (item->distance ? item->length : 1);
+    }
+    split_blocks(parser.best_items, positions, 0, num_items, splits, &num_splits);
+    splits[num_splits] = num_items;
+
+    // Then parse each block with its own cost model
+    segment->output = vec_construct_empty();
+    BITWRITER* writer = bwattach(segment->output);
+    size_t block_start = history;
+    for (size_t i = 0; i <= num_splits; i++) {
+        size_t block_end = positions[splits[i]];
+        parse_block(&parser, block_start, block_end, MAX_ITERATIONS);
+        encoder_write_block(writer, parser.best_items, parser.num_best_items, (const char*) parser.data + block_start,
+                            block_end - block_start, segment->final && i == num_splits);
+        block_start = block_end;
+    }
+    // Stored blocks are padded relative to the start of the segment, so the next segment has to start on a byte boundary
+    if (!segment->final) encoder_align(writer);
+    segment->bits = bwtell(writer);
+    bwfree(writer);
+
+    free(positions);
+    free(splits);
+    free(parser.match_offsets);
+    free(parser.matches);
+    free(parser.cost);
+    free(parser.choice);
+    free(parser.items);
+    free(parser.best_items);
+}
+
+void optimal_compress(BITWRITER* writer, const char* data, size_t size, int threads) {
+    size_t num_segments = size ? (size + SEGMENT_SIZE - 1) / SEGMENT_SIZE : 1;
+    SEGMENT* segments = calloc(num_segments, sizeof(SEGMENT));
+    for (size_t i = 0; i < num_segments; i++) {
+        segments[i].data = data;
+        segments[i].start = i * SEGMENT_SIZE;
+        segments[i].end = (i + 1 < num_segments) ? (i + 1) * SEGMENT_SIZE : size;
+        segments[i].final = (i + 1 == num_segments);
+    }
+
+    workqueue_run(segments, num_segments, sizeof(SEGMENT), compress_segment, threads);
+
+    for (size_t i = 0; i < num_segments; i++) {
+        bwappend(writer, vec_data(segments[i].output), segments[i].bits);
+        vec_free(segments[i].output);
+    }
+    free(segments);
+}
\ No newline at end of file
@@ -0,0 +1,20 @@
+#ifndef OPTIMAL_H
+#define OPTIMAL_H
+
+#include "bitwriter.h"
+#include <stddef.h>
+
+/**
+ * Compresses data into a raw DEFLATE stream with slow, near-optimal parsing.
+ * The input is split into segments that are compressed on separate threads. Each segment still sees the
+ * 32 KiB of input before it, so splitting costs little besides the block boundary it forces and the empty
+ * stored block that realigns the output after each segment.
+ * 
+ * @param writer: the bit writer to write the stream to
+ * @param data: the data to compress
+ * @param size: the number of bytes to compress
+ * @param threads: the number of threads to use (at least 1)
+ */
+void optimal_compress(BITWRITER* writer, const char* data, size_t size, int threads);
+
+#endif
\ No newline at end of file
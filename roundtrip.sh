@@ -0,0 +1,39 @@
+#!/bin/sh
+# Round-trip check for the compressors: builds the command-line tool, compresses a few inputs with every
+# mode and container format, inflates the result again and compares it with the input.
+# Usage: ./roundtrip.sh [cc]
+
+set -u
+cd "$(dirname "$0")"
+CC=${1:-${CC:-cc}}
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+$CC -O2 -pthread *.c -o "$work/deflate" || exit 1
+
+: > "$work/empty"
+printf 'x' > "$work/byte"
+head -c 300000 /dev/urandom > "$work/random"
+cat *.c *.h > "$work/text"
+head -c 300000 /dev/zero > "$work/zeros"
+
+failures=0
+for mode in "-z" "-z -j 4" "-p" "-p -j 4" "-p --independent" "-p --chunk 1K" "-p --chunk 7"; do
+    for format in raw zlib gzip; do
+        for input in empty byte random text zeros; do
+            # shellcheck disable=SC2086
+            if ! "$work/deflate" $mode -c --format "$format" "$work/$input" > "$work/compressed" ||
+               ! "$work/deflate" -d -c --format "$format" "$work/compressed" > "$work/inflated" ||
+               ! cmp -s "$work/$input" "$work/inflated"; then
+                echo "FAIL: $mode --format $format $input"
+                failures=$((failures + 1))
+            fi
+        done
+    done
+done
+
+if [ "$failures" -ne 0 ]; then
+    echo "$failures round trips failed"
+    exit 1
+fi
+echo "all round trips passed"
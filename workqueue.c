@@ -0,0 +1,47 @@
+#include "workqueue.h"
+#include <pthread.h>
+#include <stdlib.h>
+
+/**
+ * State shared by the threads of a pool.
+ */
+typedef struct __WORKQUEUE {
+    char* items;
+    size_t num_items;
+    size_t item_size;
+    WORK_FUNCTION function;
+    size_t next;
+    pthread_mutex_t lock;
+} WORKQUEUE;
+
+/**
+ * Private thread entry point that processes items from the queue until none are left.
+ * 
+ * @param argument: the queue
+ * @returns NULL
+ */
+void* workqueue_thread(void* argument) {
+    WORKQUEUE* queue = argument;
+    while (1) {
+        pthread_mutex_lock(&queue->lock);
+        size_t index = queue->next++;
+        pthread_mutex_unlock(&queue->lock);
+        if (index >= queue->num_items) return NULL;
+        queue->function(queue->items + index * queue->item_size);
+    }
+}
+
+void workqueue_run(void* items, size_t num_items, size_t item_size, WORK_FUNCTION function, int threads) {
+    WORKQUEUE queue = {items, num_items, item_size, function, 0, PTHREAD_MUTEX_INITIALIZER};
+    if (threads < 1) threads = 1;
+    if ((size_t) threads > num_items) threads = num_items ? num_items : 1;
+    pthread_t* workers = calloc(threads, sizeof(pthread_t));
+    for (int i = 1; i < threads; i++) {
+        pthread_create(&workers[i], NULL, workqueue_thread, &queue);
+    }
+    workqueue_thread(&queue);
+    for (int i = 1; i < threads; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    free(workers);
+}
\ No newline at end of file
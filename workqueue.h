@@ -0,0 +1,25 @@
+#ifndef WORKQUEUE_H
+#define WORKQUEUE_H
+
+#include <stddef.h>
+
+/**
+ * Function that processes a single work item.
+ * 
+ * @param item: pointer to the item
+ */
+typedef void (*WORK_FUNCTION)(void* item);
+
+/**
+ * Processes every item of an array on a pool of threads, and returns once all of them are done.
+ * Items are handed out in order, so earlier items tend to finish first. The calling thread is one of the pool.
+ * 
+ * @param items: the array of items
+ * @param num_items: the number of items
+ * @param item_size: the size of each item in bytes
+ * @param function: the function to call on each item
+ * @param threads: the number of threads to use (at least 1)
+ */
+void workqueue_run(void* items, size_t num_items, size_t item_size, WORK_FUNCTION function, int threads);
+
+#endif
\ No newline at end of file